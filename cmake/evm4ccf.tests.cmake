@@ -12,6 +12,14 @@ if(BUILD_TESTS)
     ${TESTS_DIR}/eth_sendTransaction.cpp
     ${TESTS_DIR}/signed_transactions.cpp
     ${TESTS_DIR}/event_logs.cpp
+    ${TESTS_DIR}/hex_encoding.cpp
+    ${TESTS_DIR}/keccak.cpp
+    ${TESTS_DIR}/blocks.cpp
+    ${TESTS_DIR}/state_history.cpp
+    ${TESTS_DIR}/metrics.cpp
+    ${TESTS_DIR}/opcode_stats.cpp
+    ${TESTS_DIR}/tracing.cpp
+    ${TESTS_DIR}/arena.cpp
     ${CMAKE_CURRENT_LIST_DIR}/../src/app/evm_for_ccf.cpp
     ${EVM_CPP_FILES}
   )
@@ -25,11 +33,75 @@ if(BUILD_TESTS)
     intx::intx
   )
   
+  # Benchmarks of hot helpers, compared against the eEVM implementations
+  add_picobench(hex_bench
+    SRCS
+      ${TESTS_DIR}/hex_bench.cpp
+      ${EVM_DIR}/src/util.cpp
+    INCLUDE_DIRS
+      ${CMAKE_CURRENT_LIST_DIR}/../include
+      ${EVM_DIR}/include
+    LINK_LIBS
+      keccak_enclave
+      intx::intx
+  )
+
+  add_picobench(keccak_bench
+    SRCS
+      ${TESTS_DIR}/keccak_bench.cpp
+      ${EVM_DIR}/src/util.cpp
+    INCLUDE_DIRS
+      ${CMAKE_CURRENT_LIST_DIR}/../include
+      ${EVM_DIR}/include
+    LINK_LIBS
+      keccak_enclave
+      intx::intx
+  )
+
+  # Multi-threaded load generator, driving the app frontend directly. Runs a
+  # small load by default, configured by the LOAD_* environment variables
+  add_unit_test(load_generator
+    ${TESTS_DIR}/shared.cpp
+    ${TESTS_DIR}/load_generator.cpp
+    ${CMAKE_CURRENT_LIST_DIR}/../src/app/evm_for_ccf.cpp
+    ${EVM_CPP_FILES}
+  )
+  target_include_directories(load_generator PRIVATE
+    ${CMAKE_CURRENT_LIST_DIR}/../include
+    ${EVM_DIR}/include
+  )
+  target_link_libraries(load_generator PRIVATE
+    ${CMAKE_THREAD_LIBS_INIT}
+    keccak_enclave
+    secp256k1.host
+    intx::intx
+  )
+
+  # Benchmarks of the app's hot components, reporting ns/op and
+  # allocations/op as JSON
+  add_picobench(evm4ccf_bench
+    SRCS
+      ${TESTS_DIR}/evm4ccf_bench.cpp
+      ${EVM_CPP_FILES}
+    INCLUDE_DIRS
+      ${CMAKE_CURRENT_LIST_DIR}/../include
+      ${EVM_DIR}/include
+    LINK_LIBS
+      ccfcrypto.host
+      secp256k1.host
+      keccak_enclave
+      intx::intx
+  )
+  use_client_mbedtls(evm4ccf_bench)
+
   set(ENV_CONTRACTS_DIR "CONTRACTS_DIR=${TESTS_DIR}/contracts")
 
-  # Make compiled contracts available to app_test
+  # Make compiled contracts available to app_test, load_generator and
+  # evm4ccf_bench
   set_tests_properties(
     app_test
+    load_generator
+    evm4ccf_bench
     PROPERTIES
       ENVIRONMENT "${ENV_CONTRACTS_DIR}"
   )
@@ -0,0 +1,90 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#pragma once
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#  define EVM4CCF_X86
+#  ifndef INSIDE_ENCLAVE
+#    include <cpuid.h>
+#  endif
+#endif
+
+namespace evm4ccf
+{
+  // Instruction set extensions used by the vectorised codecs and hashes.
+  // On the host these are queried once and cached. CPUID is illegal inside an
+  // SGX enclave, where executing it causes an exit to be emulated, so enclave
+  // builds only use the extensions they are compiled for (eg with -mavx2). On
+  // non-x86 builds everything is reported as unavailable, and only the scalar
+  // implementations are used.
+  struct CpuFeatures
+  {
+    bool ssse3 = false;
+    bool sse41 = false;
+    bool avx2 = false;
+    bool bmi1 = false;
+    bool bmi2 = false;
+  };
+
+  inline CpuFeatures detect_cpu_features()
+  {
+    CpuFeatures f;
+
+#if defined(EVM4CCF_X86) && defined(INSIDE_ENCLAVE)
+#  ifdef __SSSE3__
+    f.ssse3 = true;
+#  endif
+#  ifdef __SSE4_1__
+    f.sse41 = true;
+#  endif
+#  ifdef __AVX2__
+    f.avx2 = true;
+#  endif
+#  ifdef __BMI__
+    f.bmi1 = true;
+#  endif
+#  ifdef __BMI2__
+    f.bmi2 = true;
+#  endif
+#elif defined(EVM4CCF_X86)
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    {
+      return f;
+    }
+
+    f.ssse3 = (ecx & (1u << 9)) != 0;
+    f.sse41 = (ecx & (1u << 19)) != 0;
+
+    // AVX state must also be enabled by the OS (XCR0 bits 1 and 2) before
+    // ymm registers can be used
+    const bool osxsave = (ecx & (1u << 27)) != 0;
+    const bool avx = (ecx & (1u << 28)) != 0;
+    bool ymm_enabled = false;
+    if (osxsave && avx)
+    {
+      uint32_t xcr0_lo, xcr0_hi;
+      __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+      ymm_enabled = (xcr0_lo & 0x6) == 0x6;
+    }
+
+    if (__get_cpuid_max(0, nullptr) >= 7)
+    {
+      __cpuid_count(7, 0, eax, ebx, ecx, edx);
+      f.avx2 = ymm_enabled && (ebx & (1u << 5)) != 0;
+      f.bmi1 = (ebx & (1u << 3)) != 0;
+      f.bmi2 = (ebx & (1u << 8)) != 0;
+    }
+#endif
+
+    return f;
+  }
+
+  inline const CpuFeatures& cpu_features()
+  {
+    static const CpuFeatures features = detect_cpu_features();
+    return features;
+  }
+} // namespace evm4ccf
@@ -2,6 +2,9 @@
 // Licensed under the MIT License.
 #pragma once
 
+#include "hex_encoding.h"
+#include "keccak256.h"
+#include "rlp_view.h"
 #include "rpc_types.h"
 
 // CCF
@@ -111,6 +114,176 @@ namespace evm4ccf
     return encoded;
   }
 
+  // Legacy transactions begin with an RLP list prefix, which is at least 0xc0
+  inline bool is_typed_transaction(CBuffer encoded)
+  {
+    return encoded.n != 0 && encoded.p[0] < 0x80;
+  }
+
+  inline uint8_t get_transaction_type(CBuffer encoded)
+  {
+    if (!is_typed_transaction(encoded))
+    {
+      return legacy_transaction_type;
+    }
+
+    const auto type = encoded.p[0];
+    if (type != access_list_transaction_type)
+    {
+      throw rlp_view::DecodeError(
+        fmt::format("Unsupported transaction type {:#x}", type));
+    }
+    return type;
+  }
+
+  // Typed transactions carry their chain ID explicitly, and the y parity of
+  // the signature in place of v
+  inline size_t from_typed_recovery_id(size_t chain_id, uint8_t y_parity)
+  {
+    if (chain_id != current_chain_id)
+    {
+      throw std::logic_error(fmt::format(
+        "Transaction is for chain ID {}, expected current chain ID {}",
+        chain_id,
+        current_chain_id));
+    }
+
+    if (y_parity > 1)
+    {
+      throw std::logic_error(fmt::format(
+        "Signature y parity should be 0 or 1, {} is invalid", y_parity));
+    }
+
+    return y_parity;
+  }
+
+  inline void append_rlp_list(
+    eevm::rlp::ByteString& out, const uint8_t* payload, size_t n)
+  {
+    uint8_t header[rlp_view::max_header_size];
+    const auto header_size = rlp_view::encode_list_header(n, header);
+    out.insert(out.end(), header, header + header_size);
+    out.insert(out.end(), payload, payload + n);
+  }
+
+  inline void append_rlp_string(
+    eevm::rlp::ByteString& out, const uint8_t* bytes, size_t n)
+  {
+    // Only used for addresses and storage keys, which are never long enough
+    // to need a length prefix, nor short enough to be encoded as one byte
+    out.push_back((uint8_t)(0x80 + n));
+    out.insert(out.end(), bytes, bytes + n);
+  }
+
+  inline eevm::rlp::ByteString encode_access_list(const AccessList& access_list)
+  {
+    eevm::rlp::ByteString entries;
+    for (const auto& entry : access_list)
+    {
+      eevm::rlp::ByteString keys;
+      for (const auto& key : entry.storage_keys)
+      {
+        uint8_t key_bytes[32];
+        eevm::to_big_endian(key, key_bytes);
+        append_rlp_string(keys, key_bytes, sizeof(key_bytes));
+      }
+
+      const auto address = encode_optional_address(entry.address);
+      eevm::rlp::ByteString fields;
+      append_rlp_string(fields, address.data(), address.size());
+      append_rlp_list(fields, keys.data(), keys.size());
+
+      append_rlp_list(entries, fields.data(), fields.size());
+    }
+
+    eevm::rlp::ByteString encoded;
+    append_rlp_list(encoded, entries.data(), entries.size());
+    return encoded;
+  }
+
+  inline AccessList decode_access_list(const rlp_view::Item& item)
+  {
+    constexpr size_t address_length = 20;
+    constexpr size_t key_length = 32;
+
+    AccessList access_list;
+    rlp_view::ListReader entries(item);
+    while (!entries.empty())
+    {
+      rlp_view::ListReader fields(entries.next());
+
+      const auto address = fields.next_bytes();
+      if (address.n != address_length)
+      {
+        throw rlp_view::DecodeError(fmt::format(
+          "Access list address should be {} bytes, not {}",
+          address_length,
+          address.n));
+      }
+
+      AccessListEntry entry;
+      entry.address = eevm::from_big_endian(address.p, address.n);
+
+      rlp_view::ListReader keys(fields.next());
+      while (!keys.empty())
+      {
+        const auto key = keys.next_bytes();
+        if (key.n != key_length)
+        {
+          throw rlp_view::DecodeError(fmt::format(
+            "Access list storage key should be {} bytes, not {}",
+            key_length,
+            key.n));
+        }
+        entry.storage_keys.push_back(eevm::from_big_endian(key.p, key.n));
+      }
+
+      if (!fields.empty())
+      {
+        throw rlp_view::DecodeError(
+          "Access list entry contains unexpected trailing fields");
+      }
+
+      access_list.push_back(std::move(entry));
+    }
+    return access_list;
+  }
+
+  // eevm::rlp cannot nest an access list within a list of fields, so typed
+  // transactions are assembled from encoded parts. Each of leading_fields and
+  // trailing_fields is an encoded list, whose items surround the access list
+  inline eevm::rlp::ByteString encode_typed_transaction(
+    uint8_t type,
+    const eevm::rlp::ByteString& leading_fields,
+    const AccessList& access_list,
+    const eevm::rlp::ByteString& trailing_fields = {})
+  {
+    eevm::rlp::ByteString fields;
+
+    const auto leading =
+      rlp_view::decode({leading_fields.data(), leading_fields.size()});
+    fields.insert(
+      fields.end(), leading.payload.p, leading.payload.p + leading.payload.n);
+
+    const auto encoded_access_list = encode_access_list(access_list);
+    fields.insert(
+      fields.end(), encoded_access_list.begin(), encoded_access_list.end());
+
+    if (!trailing_fields.empty())
+    {
+      const auto trailing =
+        rlp_view::decode({trailing_fields.data(), trailing_fields.size()});
+      fields.insert(
+        fields.end(),
+        trailing.payload.p,
+        trailing.payload.p + trailing.payload.n);
+    }
+
+    eevm::rlp::ByteString encoded{type};
+    append_rlp_list(encoded, fields.data(), fields.size());
+    return encoded;
+  }
+
   inline eevm::Address get_address_from_public_key_asn1(
     const std::vector<uint8_t>& asn1)
   {
@@ -124,19 +297,67 @@ namespace evm4ccf
         asn1[0]));
     }
 
-    const std::vector<uint8_t> bytes(asn1.begin() + 1, asn1.end());
-    const auto hashed = eevm::keccak_256(bytes);
+    const auto hashed = keccak::keccak_256(asn1.data() + 1, asn1.size() - 1);
 
     // Address is the last 20 bytes of 32-byte hash, so skip first 12
     return eevm::from_big_endian(hashed.data() + 12, 20u);
   }
 
+  // The type is carried from the envelope or the JSON call, so an EIP-2930
+  // transaction with an empty access list keeps its own encoding and hash
+  inline void check_transaction_type(const MessageCall& mc)
+  {
+    if (
+      mc.type != legacy_transaction_type &&
+      mc.type != access_list_transaction_type)
+    {
+      throw std::logic_error(
+        fmt::format("Unsupported transaction type {:#x}", mc.type));
+    }
+
+    if (mc.type == legacy_transaction_type && !mc.access_list.empty())
+    {
+      throw std::logic_error("Legacy transactions cannot carry an access list");
+    }
+  }
+
+  // RLP encoding of an unsigned transaction, produced directly from a
+  // MessageCall without first copying its data into an EthereumTransaction
+  inline eevm::rlp::ByteString encode_unsigned_transaction(
+    size_t nonce, const MessageCall& mc)
+  {
+    check_transaction_type(mc);
+    if (mc.type != legacy_transaction_type)
+    {
+      return encode_typed_transaction(
+        access_list_transaction_type,
+        eevm::rlp::encode(
+          current_chain_id,
+          nonce,
+          mc.gas_price,
+          mc.gas,
+          encode_optional_address(mc.to),
+          mc.value,
+          mc.data),
+        mc.access_list);
+    }
+
+    return eevm::rlp::encode(
+      nonce,
+      mc.gas_price,
+      mc.gas,
+      encode_optional_address(mc.to),
+      mc.value,
+      mc.data);
+  }
+
   struct EthereumTransaction
   {
   protected:
     EthereumTransaction() {}
 
   public:
+    uint8_t type = legacy_transaction_type;
     size_t nonce;
     uint256_t gas_price;
     uint256_t gas;
@@ -144,18 +365,60 @@ namespace evm4ccf
     uint256_t value;
     eevm::rlp::ByteString data;
 
-    EthereumTransaction(size_t nonce_, const rpcparams::MessageCall& tc)
+    // Only present in typed transactions
+    size_t chain_id = 0;
+    AccessList access_list = {};
+
+    EthereumTransaction(size_t nonce_, const MessageCall& mc)
     {
+      check_transaction_type(mc);
+      type = mc.type;
+      if (type != legacy_transaction_type)
+      {
+        chain_id = current_chain_id;
+        access_list = mc.access_list;
+      }
+
       nonce = nonce_;
-      gas_price = tc.gas_price;
-      gas = tc.gas;
-      to = encode_optional_address(tc.to);
-      value = tc.value;
-      data = eevm::to_bytes(tc.data);
+      gas_price = mc.gas_price;
+      gas = mc.gas;
+      to = encode_optional_address(mc.to);
+      value = mc.value;
+      data = mc.data;
     }
 
+    EthereumTransaction(size_t nonce_, const rpcparams::MessageCall& tc) :
+      EthereumTransaction(nonce_, MessageCall(tc))
+    {}
+
     EthereumTransaction(const eevm::rlp::ByteString& encoded)
     {
+      const CBuffer buffer = {encoded.data(), encoded.size()};
+      type = get_transaction_type(buffer);
+      if (type != legacy_transaction_type)
+      {
+        rlp_view::ListReader fields(
+          rlp_view::decode({buffer.p + 1, buffer.n - 1}));
+
+        chain_id = fields.next_int<size_t>();
+        nonce = fields.next_int<size_t>();
+        gas_price = fields.next_int<uint256_t>();
+        gas = fields.next_int<uint256_t>();
+        const auto to_bytes = fields.next_bytes();
+        to.assign(to_bytes.p, to_bytes.p + to_bytes.n);
+        value = fields.next_int<uint256_t>();
+        const auto data_bytes = fields.next_bytes();
+        data.assign(data_bytes.p, data_bytes.p + data_bytes.n);
+        access_list = decode_access_list(fields.next());
+
+        if (!fields.empty())
+        {
+          throw rlp_view::DecodeError(
+            "Transaction contains unexpected trailing fields");
+        }
+        return;
+      }
+
       auto tup = eevm::rlp::decode<
         size_t,
         uint256_t,
@@ -174,37 +437,262 @@ namespace evm4ccf
 
     eevm::rlp::ByteString encode() const
     {
+      if (type != legacy_transaction_type)
+      {
+        return encode_typed_transaction(
+          type,
+          eevm::rlp::encode(chain_id, nonce, gas_price, gas, to, value, data),
+          access_list);
+      }
+
       return eevm::rlp::encode(nonce, gas_price, gas, to, value, data);
     }
 
+    // For typed transactions, this is the hash of the type byte followed by
+    // the unsigned fields, as specified by EIP-2930
     virtual eevm::KeccakHash to_be_signed() const
     {
-      return eevm::keccak_256(encode());
+      return keccak::keccak_256(encode());
     }
 
-    virtual void to_transaction_call(rpcparams::MessageCall& tc) const
+    virtual void to_message_call(MessageCall& mc) const
     {
-      tc.gas_price = gas_price;
-      tc.gas = gas;
+      mc.gas_price = gas_price;
+      mc.gas = gas;
       if (to.empty())
       {
-        tc.to = std::nullopt;
+        mc.to = std::nullopt;
+      }
+      else
+      {
+        mc.to = eevm::from_big_endian(to.data(), to.size());
+      }
+      mc.value = value;
+      mc.data = data;
+      mc.type = type;
+      mc.access_list = access_list;
+    }
+
+    void to_transaction_call(rpcparams::MessageCall& tc) const
+    {
+      MessageCall mc;
+      to_message_call(mc);
+
+      tc.from = mc.from;
+      tc.to = mc.to;
+      tc.gas = mc.gas;
+      tc.gas_price = mc.gas_price;
+      tc.value = mc.value;
+      tc.data = hex::to_hex_string(mc.data);
+      tc.type = mc.type;
+      tc.access_list = mc.access_list;
+    }
+  };
+
+  // In tls::RecoverableSignature, r and s are combined in a single fixed-size
+  // array. The first 32 bytes contain r, the second 32 contain s.
+  static constexpr size_t r_fixed_length = 32u;
+
+  inline void to_recoverable_signature(
+    uint8_t v,
+    const uint256_t& r,
+    const uint256_t& s,
+    tls::RecoverableSignature& sig)
+  {
+    sig.recovery_id = from_ethereum_recovery_id(v);
+
+    const auto s_begin = sig.raw.data() + r_fixed_length;
+    eevm::to_big_endian(r, sig.raw.data());
+    eevm::to_big_endian(s, s_begin);
+  }
+
+  inline void to_recoverable_signature(
+    uint8_t type,
+    size_t chain_id,
+    uint8_t v,
+    const uint256_t& r,
+    const uint256_t& s,
+    tls::RecoverableSignature& sig)
+  {
+    if (type == legacy_transaction_type)
+    {
+      to_recoverable_signature(v, r, s, sig);
+      return;
+    }
+
+    sig.recovery_id = from_typed_recovery_id(chain_id, v);
+
+    const auto s_begin = sig.raw.data() + r_fixed_length;
+    eevm::to_big_endian(r, sig.raw.data());
+    eevm::to_big_endian(s, s_begin);
+  }
+
+  inline eevm::Address recover_sender(
+    const tls::RecoverableSignature& sig, const eevm::KeccakHash& tbs)
+  {
+    auto pubk =
+      tls::PublicKey_k1Bitcoin::recover_key(sig, {tbs.data(), tbs.size()});
+    return get_address_from_public_key_asn1(pubk.public_key_asn1());
+  }
+
+  // Non-owning view of a signed transaction, decoded in place from its RLP
+  // encoding. The byte string fields point into the encoded buffer, so a view
+  // must not outlive it. EthereumTransactionWithSignature can be constructed
+  // from a view when the transaction needs to own its data.
+  struct SignedTransactionView
+  {
+    uint8_t type = legacy_transaction_type;
+    size_t nonce;
+    uint256_t gas_price;
+    uint256_t gas;
+    CBuffer to;
+    uint256_t value;
+    CBuffer data;
+    uint8_t v;
+    uint256_t r;
+    uint256_t s;
+
+    // Only present in typed transactions, where v is the signature's y parity
+    size_t chain_id = 0;
+    rlp_view::Item access_list = {};
+
+    // Encodings of the unsigned fields, which are contiguous within the
+    // transaction. Signing payloads are built from these without re-encoding
+    CBuffer unsigned_fields;
+
+    explicit SignedTransactionView(CBuffer encoded)
+    {
+      type = get_transaction_type(encoded);
+      if (type != legacy_transaction_type)
+      {
+        encoded = {encoded.p + 1, encoded.n - 1};
+      }
+
+      rlp_view::ListReader fields(rlp_view::decode(encoded));
+
+      const auto unsigned_begin = fields.rest().p;
+      if (type != legacy_transaction_type)
+      {
+        chain_id = fields.next_int<size_t>();
+      }
+      nonce = fields.next_int<size_t>();
+      gas_price = fields.next_int<uint256_t>();
+      gas = fields.next_int<uint256_t>();
+      to = fields.next_bytes();
+      value = fields.next_int<uint256_t>();
+      data = fields.next_bytes();
+      if (type != legacy_transaction_type)
+      {
+        access_list = fields.next();
+        if (!access_list.is_list)
+        {
+          throw rlp_view::DecodeError("Expected access list, found string");
+        }
+      }
+      unsigned_fields = {unsigned_begin,
+                         (size_t)(fields.rest().p - unsigned_begin)};
+
+      v = fields.next_int<uint8_t>();
+      r = fields.next_int<uint256_t>();
+      s = fields.next_int<uint256_t>();
+
+      if (!fields.empty())
+      {
+        throw rlp_view::DecodeError(
+          "Signed transaction contains unexpected trailing fields");
+      }
+
+      constexpr size_t address_length = 20;
+      if (to.n != 0 && to.n != address_length)
+      {
+        throw rlp_view::DecodeError(fmt::format(
+          "Transaction recipient should be {} bytes, not {}",
+          address_length,
+          to.n));
+      }
+    }
+
+    eevm::KeccakHash to_be_signed() const
+    {
+      uint8_t header[rlp_view::max_header_size];
+      if (type != legacy_transaction_type)
+      {
+        // EIP-2930 hashes the type byte before the list of unsigned fields
+        const auto header_size =
+          rlp_view::encode_list_header(unsigned_fields.n, header);
+        return keccak::Hasher()
+          .update(&type, 1)
+          .update(header, header_size)
+          .update(unsigned_fields)
+          .finalize();
+      }
+
+      // EIP-155 appends (CHAIN_ID, 0, 0) to the hashed fields
+      uint8_t suffix[rlp_view::max_header_size + 2];
+      size_t suffix_size = 0;
+      if (!is_pre_eip_155(v))
+      {
+        suffix_size = rlp_view::encode_int(current_chain_id, suffix);
+        suffix[suffix_size++] = 0x80;
+        suffix[suffix_size++] = 0x80;
+      }
+
+      const auto header_size =
+        rlp_view::encode_list_header(unsigned_fields.n + suffix_size, header);
+
+      // The pieces are hashed where they lie, without assembling the payload
+      return keccak::Hasher()
+        .update(header, header_size)
+        .update(unsigned_fields)
+        .update(suffix, suffix_size)
+        .finalize();
+    }
+
+    eevm::Address recover_sender() const
+    {
+      tls::RecoverableSignature rs;
+      to_recoverable_signature(type, chain_id, v, r, s, rs);
+      return evm4ccf::recover_sender(rs, to_be_signed());
+    }
+
+    AccessList get_access_list() const
+    {
+      if (type == legacy_transaction_type)
+      {
+        return {};
+      }
+      return decode_access_list(access_list);
+    }
+
+    // Only the call data and access list are copied from the encoded buffer
+    void to_message_call(MessageCall& mc) const
+    {
+      to_message_call(mc, recover_sender());
+    }
+
+    // For a transaction whose sender has already been recovered
+    void to_message_call(MessageCall& mc, const eevm::Address& from) const
+    {
+      mc.from = from;
+      mc.gas_price = gas_price;
+      mc.gas = gas;
+      if (to.n == 0)
+      {
+        mc.to = std::nullopt;
       }
       else
       {
-        tc.to = eevm::from_big_endian(to.data(), to.size());
+        mc.to = eevm::from_big_endian(to.p, to.n);
       }
-      tc.value = value;
-      tc.data = eevm::to_hex_string(data);
+      mc.value = value;
+      mc.data.assign(data.p, data.p + data.n);
+      mc.type = type;
+      mc.access_list = get_access_list();
     }
   };
 
   struct EthereumTransactionWithSignature : public EthereumTransaction
   {
-    // In tls::RecoverableSignature, r and s are combined in a single fixed-size
-    // array. The first 32 bytes contain r, the second 32 contain s.
-    static constexpr size_t r_fixed_length = 32u;
-
     using PointCoord = uint256_t;
     uint8_t v;
     PointCoord r;
@@ -226,54 +714,59 @@ namespace evm4ccf
       const EthereumTransaction& tx, const tls::RecoverableSignature& sig) :
       EthereumTransaction(tx)
     {
-      v = to_ethereum_recovery_id(sig.recovery_id);
+      v = type == legacy_transaction_type ?
+        to_ethereum_recovery_id(sig.recovery_id) :
+        sig.recovery_id;
 
       const auto s_data = sig.raw.begin() + r_fixed_length;
       r = eevm::from_big_endian(sig.raw.data(), r_fixed_length);
       s = eevm::from_big_endian(s_data, r_fixed_length);
     }
 
-    EthereumTransactionWithSignature(const eevm::rlp::ByteString& encoded)
+    explicit EthereumTransactionWithSignature(
+      const SignedTransactionView& view)
     {
-      auto tup = eevm::rlp::decode<
-        size_t,
-        uint256_t,
-        uint256_t,
-        eevm::rlp::ByteString,
-        uint256_t,
-        eevm::rlp::ByteString,
-        uint8_t,
-        PointCoord,
-        PointCoord>(encoded);
-
-      nonce = std::get<0>(tup);
-      gas_price = std::get<1>(tup);
-      gas = std::get<2>(tup);
-      to = std::get<3>(tup);
-      value = std::get<4>(tup);
-      data = std::get<5>(tup);
-      v = std::get<6>(tup);
-      r = std::get<7>(tup);
-      s = std::get<8>(tup);
+      type = view.type;
+      chain_id = view.chain_id;
+      access_list = view.get_access_list();
+      nonce = view.nonce;
+      gas_price = view.gas_price;
+      gas = view.gas;
+      to.assign(view.to.p, view.to.p + view.to.n);
+      value = view.value;
+      data.assign(view.data.p, view.data.p + view.data.n);
+      v = view.v;
+      r = view.r;
+      s = view.s;
     }
 
+    EthereumTransactionWithSignature(const eevm::rlp::ByteString& encoded) :
+      EthereumTransactionWithSignature(
+        SignedTransactionView({encoded.data(), encoded.size()}))
+    {}
+
     eevm::rlp::ByteString encode() const
     {
+      if (type != legacy_transaction_type)
+      {
+        return encode_typed_transaction(
+          type,
+          eevm::rlp::encode(chain_id, nonce, gas_price, gas, to, value, data),
+          access_list,
+          eevm::rlp::encode(v, r, s));
+      }
+
       return eevm::rlp::encode(nonce, gas_price, gas, to, value, data, v, r, s);
     }
 
     void to_recoverable_signature(tls::RecoverableSignature& sig) const
     {
-      sig.recovery_id = from_ethereum_recovery_id(v);
-
-      const auto s_begin = sig.raw.data() + r_fixed_length;
-      eevm::to_big_endian(r, sig.raw.data());
-      eevm::to_big_endian(s, s_begin);
+      evm4ccf::to_recoverable_signature(type, chain_id, v, r, s, sig);
     }
 
     eevm::KeccakHash to_be_signed() const override
     {
-      if (is_pre_eip_155(v))
+      if (type != legacy_transaction_type || is_pre_eip_155(v))
       {
         return EthereumTransaction::to_be_signed();
       }
@@ -281,20 +774,17 @@ namespace evm4ccf
       // EIP-155 adds (CHAIN_ID, 0, 0) to the data which is hashed, but _only_
       // for signing/recovering. The canonical transaction hash (produced by
       // encode(), used as transaction ID) is unaffected
-      return eevm::keccak_256(eevm::rlp::encode(
+      return keccak::keccak_256(eevm::rlp::encode(
         nonce, gas_price, gas, to, value, data, current_chain_id, 0, 0));
     }
 
-    void to_transaction_call(rpcparams::MessageCall& tc) const override
+    void to_message_call(MessageCall& mc) const override
     {
-      EthereumTransaction::to_transaction_call(tc);
+      EthereumTransaction::to_message_call(mc);
 
       tls::RecoverableSignature rs;
       to_recoverable_signature(rs);
-      const auto tbs = to_be_signed();
-      auto pubk =
-        tls::PublicKey_k1Bitcoin::recover_key(rs, {tbs.data(), tbs.size()});
-      tc.from = get_address_from_public_key_asn1(pubk.public_key_asn1());
+      mc.from = recover_sender(rs, to_be_signed());
     }
   };
 
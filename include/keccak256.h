@@ -0,0 +1,502 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#pragma once
+
+#include "cpu_features.h"
+#include "hex_encoding.h"
+
+// CCF
+#include "ds/buffer.h"
+
+// eEVM
+#include <eEVM/rlp.h>
+#include <eEVM/util.h>
+
+// STL
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef EVM4CCF_X86
+#  include <immintrin.h>
+#endif
+
+// Keccak-256, as used by Ethereum (original Keccak padding, not SHA3-256).
+// This replaces the reference keccak_enclave sources for the hashes computed
+// by the app itself: transaction hashes, signing payloads, contract addresses
+// and address checksums. Hashes computed by EVM bytecode (SHA3) are still
+// eEVM's, since its Processor runs that opcode.
+//
+// The permutation is compiled for BMI1/BMI2 (andn, rorx) where the CPU
+// supports them, and keccak_256_x4 hashes 4 independent inputs at once in the
+// 64-bit lanes of AVX2 registers. Inside the enclave the CPU cannot be
+// queried (see cpu_features.h), so the enclave uses the scalar permutation
+// unless the app is compiled with -mbmi2 and -mavx2.
+namespace evm4ccf::keccak
+{
+  static constexpr size_t hash_size = 32;
+
+  // Bytes absorbed per permutation, for a capacity of 512 bits
+  static constexpr size_t rate = 136;
+  static constexpr size_t rate_lanes = rate / 8;
+
+  static constexpr size_t state_lanes = 25;
+
+  namespace detail
+  {
+    static constexpr uint64_t round_constants[24] = {
+      0x0000000000000001, 0x0000000000008082, 0x800000000000808a,
+      0x8000000080008000, 0x000000000000808b, 0x0000000080000001,
+      0x8000000080008081, 0x8000000000008009, 0x000000000000008a,
+      0x0000000000000088, 0x0000000080008009, 0x000000008000000a,
+      0x000000008000808b, 0x800000000000008b, 0x8000000000008089,
+      0x8000000000008003, 0x8000000000008002, 0x8000000000000080,
+      0x000000000000800a, 0x800000008000000a, 0x8000000080008081,
+      0x8000000000008080, 0x0000000080000001, 0x8000000080008008};
+
+    // Rho rotation of each lane, and the position the pi step moves it to.
+    // Lane (x, y) is at index x + 5y
+    static constexpr unsigned rotations[25] = {0,  1,  62, 28, 27, 36, 44,
+                                               6,  55, 20, 3,  10, 43, 25,
+                                               39, 41, 45, 15, 21, 8,  18,
+                                               2,  61, 56, 14};
+
+    static constexpr unsigned pi_lanes[25] = {0,  10, 20, 5,  15, 16, 1,
+                                              11, 21, 6,  7,  17, 2,  12,
+                                              22, 23, 8,  18, 3,  13, 14,
+                                              24, 9,  19, 4};
+
+    // Lanes are little-endian
+    inline uint64_t load_lane(const uint8_t* p)
+    {
+      uint64_t v;
+      std::memcpy(&v, p, sizeof(v));
+      return v;
+    }
+
+    inline void store_lane(uint64_t v, uint8_t* p)
+    {
+      std::memcpy(p, &v, sizeof(v));
+    }
+
+    inline uint64_t rotl(uint64_t v, unsigned n)
+    {
+      return n == 0 ? v : (v << n) | (v >> (64 - n));
+    }
+
+    // Always inlined so that each caller below is compiled for its own
+    // target. The loops are fully unrolled, so every lane index is a constant
+    // and the state can stay in registers.
+    __attribute__((always_inline)) inline void keccak_f(uint64_t* a)
+    {
+      for (size_t round = 0; round < 24; ++round)
+      {
+        // Theta
+        uint64_t c[5];
+#pragma GCC unroll 5
+        for (size_t x = 0; x < 5; ++x)
+        {
+          c[x] = a[x] ^ a[x + 5] ^ a[x + 10] ^ a[x + 15] ^ a[x + 20];
+        }
+
+        uint64_t d[5];
+#pragma GCC unroll 5
+        for (size_t x = 0; x < 5; ++x)
+        {
+          d[x] = c[(x + 4) % 5] ^ rotl(c[(x + 1) % 5], 1);
+        }
+
+        // Rho and pi
+        uint64_t b[25];
+#pragma GCC unroll 25
+        for (size_t i = 0; i < 25; ++i)
+        {
+          b[pi_lanes[i]] = rotl(a[i] ^ d[i % 5], rotations[i]);
+        }
+
+        // Chi
+#pragma GCC unroll 25
+        for (size_t i = 0; i < 25; ++i)
+        {
+          const auto y = i - i % 5;
+          a[i] = b[i] ^ (~b[y + (i + 1) % 5] & b[y + (i + 2) % 5]);
+        }
+
+        // Iota
+        a[0] ^= round_constants[round];
+      }
+    }
+
+    inline void keccak_f_scalar(uint64_t* a)
+    {
+      keccak_f(a);
+    }
+
+#ifdef EVM4CCF_X86
+    __attribute__((target("bmi,bmi2"))) inline void keccak_f_bmi2(uint64_t* a)
+    {
+      keccak_f(a);
+    }
+
+    // Counts of 64 shift everything out, so n == 0 needs no special case
+    __attribute__((target("avx2"))) inline __m256i rotl_x4(
+      __m256i v, unsigned n)
+    {
+      return _mm256_or_si256(
+        _mm256_sllv_epi64(v, _mm256_set1_epi64x(n)),
+        _mm256_srlv_epi64(v, _mm256_set1_epi64x(64 - n)));
+    }
+
+    // Applies keccak_f to 4 states at once, with lane i of state k held in
+    // element k of a[i]
+    __attribute__((target("avx2"))) inline void keccak_f_x4(__m256i* a)
+    {
+      for (size_t round = 0; round < 24; ++round)
+      {
+        __m256i c[5];
+#pragma GCC unroll 5
+        for (size_t x = 0; x < 5; ++x)
+        {
+          c[x] = _mm256_xor_si256(
+            _mm256_xor_si256(a[x], a[x + 5]),
+            _mm256_xor_si256(
+              _mm256_xor_si256(a[x + 10], a[x + 15]), a[x + 20]));
+        }
+
+        __m256i d[5];
+#pragma GCC unroll 5
+        for (size_t x = 0; x < 5; ++x)
+        {
+          d[x] = _mm256_xor_si256(c[(x + 4) % 5], rotl_x4(c[(x + 1) % 5], 1));
+        }
+
+        __m256i b[25];
+#pragma GCC unroll 25
+        for (size_t i = 0; i < 25; ++i)
+        {
+          b[pi_lanes[i]] =
+            rotl_x4(_mm256_xor_si256(a[i], d[i % 5]), rotations[i]);
+        }
+
+#pragma GCC unroll 25
+        for (size_t i = 0; i < 25; ++i)
+        {
+          // andnot(p, q) computes ~p & q
+          const auto y = i - i % 5;
+          a[i] = _mm256_xor_si256(
+            b[i], _mm256_andnot_si256(b[y + (i + 1) % 5], b[y + (i + 2) % 5]));
+        }
+
+        a[0] = _mm256_xor_si256(
+          a[0], _mm256_set1_epi64x((int64_t)round_constants[round]));
+      }
+    }
+#endif
+
+    using Permutation = void (*)(uint64_t*);
+
+    inline Permutation select_permutation()
+    {
+#ifdef EVM4CCF_X86
+      const auto& cpu = cpu_features();
+      if (cpu.bmi1 && cpu.bmi2)
+      {
+        return keccak_f_bmi2;
+      }
+#endif
+      return keccak_f_scalar;
+    }
+
+    inline Permutation permutation()
+    {
+      static const Permutation p = select_permutation();
+      return p;
+    }
+
+    // Writes the final, padded block of an input of the given size to block
+    inline void pad_final_block(
+      const uint8_t* data, size_t size, uint8_t (&block)[rate])
+    {
+      const auto tail = size % rate;
+      if (tail != 0)
+      {
+        std::memcpy(block, data + size - tail, tail);
+      }
+      std::memset(block + tail, 0, rate - tail);
+      block[tail] ^= 0x01;
+      block[rate - 1] ^= 0x80;
+    }
+  } // namespace detail
+
+  // Incremental hasher, for inputs which are assembled from several pieces
+  class Hasher
+  {
+    uint64_t state[state_lanes] = {};
+    uint8_t buffer[rate];
+    size_t buffered = 0;
+    detail::Permutation permute;
+
+    void absorb(const uint8_t* block)
+    {
+      for (size_t i = 0; i < rate_lanes; ++i)
+      {
+        state[i] ^= detail::load_lane(block + 8 * i);
+      }
+      permute(state);
+    }
+
+  public:
+    Hasher() : permute(detail::permutation()) {}
+
+    Hasher& update(const uint8_t* data, size_t size)
+    {
+      if (size == 0)
+      {
+        return *this;
+      }
+
+      if (buffered != 0)
+      {
+        const auto n = std::min(size, rate - buffered);
+        std::memcpy(buffer + buffered, data, n);
+        buffered += n;
+        data += n;
+        size -= n;
+
+        if (buffered < rate)
+        {
+          return *this;
+        }
+
+        absorb(buffer);
+        buffered = 0;
+      }
+
+      for (; size >= rate; data += rate, size -= rate)
+      {
+        absorb(data);
+      }
+
+      if (size != 0)
+      {
+        std::memcpy(buffer, data, size);
+        buffered = size;
+      }
+      return *this;
+    }
+
+    Hasher& update(CBuffer b)
+    {
+      return update(b.p, b.n);
+    }
+
+    // Writes the 32-byte digest to out. The hasher must not be used again
+    void finalize(uint8_t* out)
+    {
+      std::memset(buffer + buffered, 0, rate - buffered);
+      buffer[buffered] ^= 0x01;
+      buffer[rate - 1] ^= 0x80;
+      absorb(buffer);
+
+      for (size_t i = 0; i < hash_size / 8; ++i)
+      {
+        detail::store_lane(state[i], out + 8 * i);
+      }
+    }
+
+    eevm::KeccakHash finalize()
+    {
+      eevm::KeccakHash h;
+      finalize(h.data());
+      return h;
+    }
+  };
+
+  inline void keccak_256(const uint8_t* data, size_t size, uint8_t* out)
+  {
+    Hasher().update(data, size).finalize(out);
+  }
+
+  inline eevm::KeccakHash keccak_256(const uint8_t* data, size_t size)
+  {
+    return Hasher().update(data, size).finalize();
+  }
+
+  inline eevm::KeccakHash keccak_256(const std::vector<uint8_t>& v)
+  {
+    return keccak_256(v.data(), v.size());
+  }
+
+  inline eevm::KeccakHash keccak_256(const std::string& s)
+  {
+    return keccak_256(reinterpret_cast<const uint8_t*>(s.data()), s.size());
+  }
+
+  namespace detail
+  {
+    inline void keccak_256_x4_scalar(
+      const CBuffer (&inputs)[4], uint8_t* const (&out)[4])
+    {
+      for (size_t k = 0; k < 4; ++k)
+      {
+        keccak_256(inputs[k].p, inputs[k].n, out[k]);
+      }
+    }
+
+#ifdef EVM4CCF_X86
+    __attribute__((target("avx2"))) inline void keccak_256_x4_avx2(
+      const CBuffer (&inputs)[4], uint8_t* const (&out)[4])
+    {
+      static constexpr uint8_t finished[rate] = {};
+
+      // Every input is padded to a whole number of blocks, so the final block
+      // holds between 0 and rate - 1 bytes of the input
+      uint8_t final_blocks[4][rate];
+      size_t n_blocks[4];
+      size_t max_blocks = 0;
+      for (size_t k = 0; k < 4; ++k)
+      {
+        pad_final_block(inputs[k].p, inputs[k].n, final_blocks[k]);
+        n_blocks[k] = inputs[k].n / rate + 1;
+        max_blocks = std::max(max_blocks, n_blocks[k]);
+      }
+
+      __m256i state[state_lanes];
+      for (auto& lane : state)
+      {
+        lane = _mm256_setzero_si256();
+      }
+
+      for (size_t b = 0; b < max_blocks; ++b)
+      {
+        // Inputs with fewer blocks absorb zeros once their digest has been
+        // taken, which leaves the other states unaffected
+        const uint8_t* blocks[4];
+        for (size_t k = 0; k < 4; ++k)
+        {
+          if (b + 1 < n_blocks[k])
+          {
+            blocks[k] = inputs[k].p + b * rate;
+          }
+          else if (b + 1 == n_blocks[k])
+          {
+            blocks[k] = final_blocks[k];
+          }
+          else
+          {
+            blocks[k] = finished;
+          }
+        }
+
+        for (size_t i = 0; i < rate_lanes; ++i)
+        {
+          const auto lanes = _mm256_set_epi64x(
+            (int64_t)load_lane(blocks[3] + 8 * i),
+            (int64_t)load_lane(blocks[2] + 8 * i),
+            (int64_t)load_lane(blocks[1] + 8 * i),
+            (int64_t)load_lane(blocks[0] + 8 * i));
+          state[i] = _mm256_xor_si256(state[i], lanes);
+        }
+
+        keccak_f_x4(state);
+
+        for (size_t i = 0; i < hash_size / 8; ++i)
+        {
+          alignas(32) uint64_t lanes[4];
+          _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), state[i]);
+          for (size_t k = 0; k < 4; ++k)
+          {
+            if (b + 1 == n_blocks[k])
+            {
+              store_lane(lanes[k], out[k] + 8 * i);
+            }
+          }
+        }
+      }
+    }
+#endif
+  } // namespace detail
+
+  // Hashes 4 independent inputs, writing the digest of inputs[k] to out[k].
+  // Inputs may differ in length, but the work done is that of the longest.
+  inline void keccak_256_x4(
+    const CBuffer (&inputs)[4], uint8_t* const (&out)[4])
+  {
+#ifdef EVM4CCF_X86
+    if (cpu_features().avx2)
+    {
+      detail::keccak_256_x4_avx2(inputs, out);
+      return;
+    }
+#endif
+    detail::keccak_256_x4_scalar(inputs, out);
+  }
+
+  // Hashes a batch of inputs, 4 at a time where possible
+  inline std::vector<eevm::KeccakHash> keccak_256_many(
+    const std::vector<CBuffer>& inputs)
+  {
+    std::vector<eevm::KeccakHash> hashes(inputs.size());
+
+    size_t i = 0;
+    for (; i + 4 <= inputs.size(); i += 4)
+    {
+      const CBuffer group[4] = {
+        inputs[i], inputs[i + 1], inputs[i + 2], inputs[i + 3]};
+      uint8_t* const out[4] = {hashes[i].data(),
+                               hashes[i + 1].data(),
+                               hashes[i + 2].data(),
+                               hashes[i + 3].data()};
+      keccak_256_x4(group, out);
+    }
+
+    for (; i < inputs.size(); ++i)
+    {
+      keccak_256(inputs[i].p, inputs[i].n, hashes[i].data());
+    }
+
+    return hashes;
+  }
+
+  // Address of the contract created by sender's transaction with the given
+  // nonce. Replaces eevm::generate_address
+  inline eevm::Address generate_address(
+    const eevm::Address& sender, uint64_t nonce)
+  {
+    const auto h = keccak_256(eevm::rlp::encode(sender, nonce));
+
+    // Address is the last 20 bytes of 32-byte hash, so skip first 12
+    return eevm::from_big_endian(h.data() + 12, 20u);
+  }
+
+  // EIP-55 mixed-case encoding of an address. Replaces
+  // eevm::to_checksum_address
+  inline std::string to_checksum_address(const eevm::Address& address)
+  {
+    static constexpr size_t address_size = 20;
+    static constexpr size_t digits = 2 * address_size;
+
+    uint8_t word[32];
+    eevm::to_big_endian(address, word);
+
+    std::string s(2 + digits, '0');
+    s[1] = 'x';
+    char* const hex_digits = s.data() + 2;
+    hex::encode(word + 32 - address_size, address_size, hex_digits);
+
+    // Each letter is upper-cased if the matching nibble of the hash of the
+    // lower-case digits is 8 or more
+    const auto h =
+      keccak_256(reinterpret_cast<const uint8_t*>(hex_digits), digits);
+    for (size_t i = 0; i < digits; ++i)
+    {
+      const auto nibble = i % 2 == 0 ? h[i / 2] >> 4 : h[i / 2] & 0xf;
+      if (hex_digits[i] >= 'a' && nibble >= 8)
+      {
+        hex_digits[i] -= 'a' - 'A';
+      }
+    }
+    return s;
+  }
+} // namespace evm4ccf::keccak
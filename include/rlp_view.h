@@ -0,0 +1,290 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#pragma once
+
+// CCF
+#include "ds/buffer.h"
+
+// eEVM
+#include <eEVM/bigint.h>
+#include <eEVM/util.h>
+
+// STL
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+
+// Zero-copy RLP decoding. Unlike eevm::rlp::decode, which copies every byte
+// string it produces, items decoded here are views into the caller's buffer.
+// Encodings are validated as canonical in the same pass: lengths must use the
+// shortest form, and single bytes below 0x80 must not be wrapped in a string
+// prefix.
+namespace evm4ccf::rlp_view
+{
+  class DecodeError : public std::invalid_argument
+  {
+  public:
+    using std::invalid_argument::invalid_argument;
+  };
+
+  struct Item
+  {
+    bool is_list = false;
+
+    // For strings, the raw bytes. For lists, the concatenated encodings of
+    // the list's items
+    CBuffer payload = {};
+
+    // The complete encoding of this item, including its prefix
+    CBuffer encoded = {};
+  };
+
+  namespace detail
+  {
+    inline size_t read_length(const uint8_t* p, size_t length_of_length)
+    {
+      if (length_of_length > sizeof(size_t))
+      {
+        throw DecodeError(
+          fmt::format("RLP length of {} bytes is too long", length_of_length));
+      }
+
+      if (p[0] == 0)
+      {
+        throw DecodeError("RLP length has leading zeros");
+      }
+
+      size_t length = 0;
+      for (size_t i = 0; i < length_of_length; ++i)
+      {
+        length = (length << 8) | p[i];
+      }
+
+      constexpr size_t max_short_length = 55;
+      if (length <= max_short_length)
+      {
+        throw DecodeError(fmt::format(
+          "RLP long form used for short length {}, should use short form",
+          length));
+      }
+
+      return length;
+    }
+  } // namespace detail
+
+  // Decodes the item at the start of in, and advances in past it
+  inline Item next_item(CBuffer& in)
+  {
+    if (in.n == 0)
+    {
+      throw DecodeError("Unexpected end of RLP input");
+    }
+
+    const uint8_t prefix = in.p[0];
+    size_t header = 1;
+    size_t length = 0;
+    bool is_list = false;
+
+    if (prefix < 0x80)
+    {
+      // Single byte, which is its own payload
+      header = 0;
+      length = 1;
+    }
+    else if (prefix <= 0xb7)
+    {
+      length = prefix - 0x80;
+      if (length == 1 && in.n >= 2 && in.p[1] < 0x80)
+      {
+        throw DecodeError(fmt::format(
+          "Single byte {:#x} should not have a string prefix", in.p[1]));
+      }
+    }
+    else if (prefix <= 0xbf)
+    {
+      const size_t length_of_length = prefix - 0xb7;
+      if (in.n < 1 + length_of_length)
+      {
+        throw DecodeError("Unexpected end of RLP input in string length");
+      }
+      length = detail::read_length(in.p + 1, length_of_length);
+      header += length_of_length;
+    }
+    else if (prefix <= 0xf7)
+    {
+      is_list = true;
+      length = prefix - 0xc0;
+    }
+    else
+    {
+      is_list = true;
+      const size_t length_of_length = prefix - 0xf7;
+      if (in.n < 1 + length_of_length)
+      {
+        throw DecodeError("Unexpected end of RLP input in list length");
+      }
+      length = detail::read_length(in.p + 1, length_of_length);
+      header += length_of_length;
+    }
+
+    if (length > in.n - header)
+    {
+      throw DecodeError(fmt::format(
+        "RLP item claims {} bytes, but only {} remain", length, in.n - header));
+    }
+
+    Item item;
+    item.is_list = is_list;
+    item.payload = {in.p + header, length};
+    item.encoded = {in.p, header + length};
+
+    in.p += header + length;
+    in.n -= header + length;
+
+    return item;
+  }
+
+  // Decodes a buffer which must contain exactly one item
+  inline Item decode(CBuffer in)
+  {
+    const auto item = next_item(in);
+    if (in.n != 0)
+    {
+      throw DecodeError(fmt::format("{} trailing bytes after RLP item", in.n));
+    }
+    return item;
+  }
+
+  // Iterates over the items within a list
+  class ListReader
+  {
+    CBuffer remaining;
+
+  public:
+    explicit ListReader(const Item& list) : remaining(list.payload)
+    {
+      if (!list.is_list)
+      {
+        throw DecodeError("Expected RLP list, found string");
+      }
+    }
+
+    bool empty() const
+    {
+      return remaining.n == 0;
+    }
+
+    // The bytes not yet consumed
+    CBuffer rest() const
+    {
+      return remaining;
+    }
+
+    Item next()
+    {
+      return next_item(remaining);
+    }
+
+    CBuffer next_bytes()
+    {
+      const auto item = next();
+      if (item.is_list)
+      {
+        throw DecodeError("Expected RLP string, found list");
+      }
+      return item.payload;
+    }
+
+    // Canonical integers are big-endian, with no leading zeros
+    template <typename T>
+    T next_int()
+    {
+      const auto bytes = next_bytes();
+      if (bytes.n > 0 && bytes.p[0] == 0)
+      {
+        throw DecodeError("RLP integer has leading zeros");
+      }
+
+      if constexpr (std::is_same_v<T, uint256_t>)
+      {
+        if (bytes.n > 32)
+        {
+          throw DecodeError(
+            fmt::format("RLP integer of {} bytes is too large", bytes.n));
+        }
+        return eevm::from_big_endian(bytes.p, bytes.n);
+      }
+      else
+      {
+        static_assert(std::is_unsigned_v<T>);
+        if (bytes.n > sizeof(T))
+        {
+          throw DecodeError(fmt::format(
+            "RLP integer of {} bytes does not fit in {} bytes",
+            bytes.n,
+            sizeof(T)));
+        }
+
+        T value = 0;
+        for (size_t i = 0; i < bytes.n; ++i)
+        {
+          value = (T)((value << 8) | bytes.p[i]);
+        }
+        return value;
+      }
+    }
+  };
+
+  namespace detail
+  {
+    // Writes the minimal big-endian form of v to the end of a 9-byte buffer,
+    // returning the number of bytes written
+    inline size_t to_minimal_big_endian(uint64_t v, uint8_t* end)
+    {
+      size_t n = 0;
+      for (; v != 0; v >>= 8)
+      {
+        *(end - ++n) = (uint8_t)(v & 0xff);
+      }
+      return n;
+    }
+  } // namespace detail
+
+  // Maximum size of an encoded integer or list header
+  static constexpr size_t max_header_size = 9;
+
+  // Writes the prefix of a list whose items' encodings total length bytes to
+  // out, returning the number of bytes written
+  inline size_t encode_list_header(size_t length, uint8_t* out)
+  {
+    constexpr size_t max_short_length = 55;
+    if (length <= max_short_length)
+    {
+      out[0] = (uint8_t)(0xc0 + length);
+      return 1;
+    }
+
+    uint8_t be[sizeof(size_t)];
+    const auto n = detail::to_minimal_big_endian(length, be + sizeof(be));
+    out[0] = (uint8_t)(0xf7 + n);
+    std::copy(be + sizeof(be) - n, be + sizeof(be), out + 1);
+    return 1 + n;
+  }
+
+  // Writes the encoding of an unsigned integer to out, returning the number
+  // of bytes written
+  inline size_t encode_int(uint64_t v, uint8_t* out)
+  {
+    if (v != 0 && v < 0x80)
+    {
+      out[0] = (uint8_t)v;
+      return 1;
+    }
+
+    uint8_t be[sizeof(v)];
+    const auto n = detail::to_minimal_big_endian(v, be + sizeof(be));
+    out[0] = (uint8_t)(0x80 + n);
+    std::copy(be + sizeof(be) - n, be + sizeof(be), out + 1);
+    return 1 + n;
+  }
+} // namespace evm4ccf::rlp_view
@@ -2,6 +2,8 @@
 // Licensed under the MIT License.
 #pragma once
 
+#include "hex_encoding.h"
+
 #include <eEVM/address.h>
 #include <eEVM/bigint.h>
 #include <eEVM/transaction.h>
@@ -31,6 +33,27 @@ namespace evm4ccf
 
   using ContractParticipants = std::set<eevm::Address>;
 
+  // EIP-2930 access list, naming the accounts and storage slots which a
+  // transaction expects to touch
+  struct AccessListEntry
+  {
+    eevm::Address address = {};
+    std::vector<uint256_t> storage_keys = {};
+  };
+
+  inline bool operator==(const AccessListEntry& l, const AccessListEntry& r)
+  {
+    return l.address == r.address && l.storage_keys == r.storage_keys;
+  }
+
+  using AccessList = std::vector<AccessListEntry>;
+
+  // EIP-2718 transaction types. A legacy transaction is a bare RLP list, while
+  // a typed transaction is its type byte followed by an RLP list. Only typed
+  // transactions may carry an access list
+  static constexpr uint8_t legacy_transaction_type = 0x00;
+  static constexpr uint8_t access_list_transaction_type = 0x01;
+
   // TODO(eddy|#refactoring): Reconcile this with eevm::Block
   struct BlockHeader
   {
@@ -41,6 +64,8 @@ namespace evm4ccf
     uint64_t timestamp = {};
     eevm::Address miner = {};
     BlockHash block_hash = {};
+    BlockHash parent_hash = {};
+    std::vector<TxHash> transactions = {};
   };
 
   inline bool operator==(const BlockHeader& l, const BlockHeader& r)
@@ -48,7 +73,8 @@ namespace evm4ccf
     return l.number == r.number && l.difficulty == r.difficulty &&
       l.gas_limit == r.gas_limit && l.gas_used == r.gas_used &&
       l.timestamp == r.timestamp && l.miner == r.miner &&
-      l.block_hash == r.block_hash;
+      l.block_hash == r.block_hash && l.parent_hash == r.parent_hash &&
+      l.transactions == r.transactions;
   }
 
   namespace rpcparams
@@ -62,6 +88,8 @@ namespace evm4ccf
       uint256_t value = 0;
       ByteData data = {};
       std::optional<ContractParticipants> private_for = std::nullopt;
+      uint8_t type = legacy_transaction_type;
+      AccessList access_list = {};
     };
 
     struct AddressWithBlock
@@ -70,10 +98,14 @@ namespace evm4ccf
       BlockID block_id = DefaultBlockID;
     };
 
+    // The RPCs which execute a transaction take an optional object after
+    // their standard params. {"trace": true} traces the execution, whatever
+    // the tracing settings
     struct Call
     {
       MessageCall call_data = {};
       BlockID block_id = DefaultBlockID;
+      bool trace = false;
     };
 
     struct GetTransactionCount
@@ -82,6 +114,12 @@ namespace evm4ccf
       BlockID block_id = DefaultBlockID;
     };
 
+    struct GetBlockByNumber
+    {
+      BlockID block_id = DefaultBlockID;
+      bool full_transactions = false;
+    };
+
     struct GetTransactionReceipt
     {
       TxHash tx_hash = {};
@@ -90,14 +128,52 @@ namespace evm4ccf
     struct SendRawTransaction
     {
       ByteData raw_transaction = {};
+      bool trace = false;
     };
 
     struct SendTransaction
     {
       MessageCall call_data = {};
+      bool trace = false;
+    };
+
+    struct SetTracing
+    {
+      size_t sample_every = 0;
+      size_t tail_length = 64;
+      std::set<eevm::Address> addresses = {};
     };
   } // namespace rpcparams
 
+  // Internal form of rpcparams::MessageCall. The hex-encoded data is decoded
+  // exactly once at the RPC boundary, and execution works on the raw bytes
+  struct MessageCall
+  {
+    eevm::Address from = {};
+    std::optional<eevm::Address> to = std::nullopt;
+    uint256_t gas = 90000;
+    uint256_t gas_price = 0;
+    uint256_t value = 0;
+    std::vector<uint8_t> data = {};
+    std::optional<ContractParticipants> private_for = std::nullopt;
+    uint8_t type = legacy_transaction_type;
+    AccessList access_list = {};
+
+    MessageCall() = default;
+
+    explicit MessageCall(const rpcparams::MessageCall& mc) :
+      from(mc.from),
+      to(mc.to),
+      gas(mc.gas),
+      gas_price(mc.gas_price),
+      value(mc.value),
+      data(hex::to_bytes(mc.data)),
+      private_for(mc.private_for),
+      type(mc.type),
+      access_list(mc.access_list)
+    {}
+  };
+
   namespace rpcresults
   {
     struct TxReceipt
@@ -119,6 +195,9 @@ namespace evm4ccf
 
     // "A transaction receipt object, or null when no receipt was found"
     using ReceiptResponse = std::optional<TxReceipt>;
+
+    // "A block object, or null when no block was found"
+    using BlockResponse = std::optional<BlockHeader>;
   } // namespace rpcresults
 
   template <class TTag, typename TParams, typename TResult>
@@ -171,6 +250,15 @@ namespace evm4ccf
     using GetBalance =
       RpcBuilder<GetBalanceTag, rpcparams::AddressWithBlock, Balance>;
 
+    struct GetBlockByNumberTag
+    {
+      static constexpr auto name = "eth_getBlockByNumber";
+    };
+    using GetBlockByNumber = RpcBuilder<
+      GetBlockByNumberTag,
+      rpcparams::GetBlockByNumber,
+      rpcresults::BlockResponse>;
+
     struct GetCodeTag
     {
       static constexpr auto name = "eth_getCode";
@@ -210,6 +298,42 @@ namespace evm4ccf
     using SendTransaction =
       RpcBuilder<SendTransactionTag, rpcparams::SendTransaction, TxHash>;
   } // namespace ethrpc
+
+  // RPCs specific to this app, which have no Ethereum equivalent
+  namespace apprpc
+  {
+    struct GetMetricsTag
+    {
+      static constexpr auto name = "evm4ccf_getMetrics";
+    };
+    using GetMetrics = RpcBuilder<GetMetricsTag, void, nlohmann::json>;
+
+    // Only installed when built with RECORD_OPCODE_STATS
+    struct GetOpcodeStatsTag
+    {
+      static constexpr auto name = "evm4ccf_getOpcodeStats";
+    };
+    using GetOpcodeStats =
+      RpcBuilder<GetOpcodeStatsTag, void, nlohmann::json>;
+
+    struct ResetOpcodeStatsTag
+    {
+      static constexpr auto name = "evm4ccf_resetOpcodeStats";
+    };
+    using ResetOpcodeStats = RpcBuilder<ResetOpcodeStatsTag, void, bool>;
+
+    struct GetTracingTag
+    {
+      static constexpr auto name = "evm4ccf_getTracing";
+    };
+    using GetTracing = RpcBuilder<GetTracingTag, void, nlohmann::json>;
+
+    struct SetTracingTag
+    {
+      static constexpr auto name = "evm4ccf_setTracing";
+    };
+    using SetTracing = RpcBuilder<SetTracingTag, rpcparams::SetTracing, bool>;
+  } // namespace apprpc
 } // namespace evm4ccf
 
 #include "rpc_types_serialization.inl"
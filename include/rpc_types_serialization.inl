@@ -2,6 +2,9 @@
 // Licensed under the MIT License.
 #pragma once
 
+#include "hex_encoding.h"
+#include "keccak256.h"
+
 #include <eEVM/util.h>
 
 namespace evm4ccf
@@ -10,19 +13,7 @@ namespace evm4ccf
   inline void array_from_hex_string(
     std::array<uint8_t, N>& a, const std::string& s)
   {
-    const auto stripped = eevm::strip(s);
-
-    if (stripped.size() != N * 2)
-    {
-      throw std::logic_error(
-        fmt::format("Expected {} characters, got {}", N * 2, stripped.size()));
-    }
-
-    for (auto i = 0; i < N; i++)
-    {
-      a[i] = static_cast<uint8_t>(
-        strtoul(stripped.substr(i * 2, 2).c_str(), nullptr, 16));
-    }
+    hex::to_array(s, a);
   }
 
   template <typename T>
@@ -39,7 +30,7 @@ namespace evm4ccf
     }
     else
     {
-      v = eevm::to_uint256(*it);
+      v = hex::to_uint256(*it);
     }
   }
 
@@ -66,13 +57,21 @@ namespace evm4ccf
   {
     j = nlohmann::json::object();
 
-    j["number"] = eevm::to_hex_string(s.number);
-    j["difficulty"] = eevm::to_hex_string(s.difficulty);
-    j["gasLimit"] = eevm::to_hex_string(s.gas_limit);
-    j["gasUsed"] = eevm::to_hex_string(s.gas_used);
-    j["timestamp"] = eevm::to_hex_string(s.timestamp);
-    j["miner"] = eevm::to_checksum_address(s.miner);
-    j["hash"] = eevm::to_hex_string(s.block_hash);
+    j["number"] = hex::to_hex_string(s.number);
+    j["difficulty"] = hex::to_hex_string(s.difficulty);
+    j["gasLimit"] = hex::to_hex_string(s.gas_limit);
+    j["gasUsed"] = hex::to_hex_string(s.gas_used);
+    j["timestamp"] = hex::to_hex_string(s.timestamp);
+    j["miner"] = keccak::to_checksum_address(s.miner);
+    j["hash"] = hex::to_hex_string_fixed(s.block_hash);
+    j["parentHash"] = hex::to_hex_string_fixed(s.parent_hash);
+
+    auto j_txs = nlohmann::json::array();
+    for (const auto& tx_hash : s.transactions)
+    {
+      j_txs.push_back(hex::to_hex_string_fixed(tx_hash));
+    }
+    j["transactions"] = j_txs;
   }
 
   inline void from_json(const nlohmann::json& j, BlockHeader& s)
@@ -84,8 +83,72 @@ namespace evm4ccf
     s.gas_limit = eevm::to_uint64(j["gasLimit"]);
     s.gas_used = eevm::to_uint64(j["gasUsed"]);
     s.timestamp = eevm::to_uint64(j["timestamp"]);
-    s.miner = eevm::to_uint256(j["miner"]);
-    s.block_hash = eevm::to_uint256(j["hash"]);
+    s.miner = hex::to_uint256(j["miner"]);
+    s.block_hash = hex::to_uint256(j["hash"]);
+    from_optional_hex_str(j, "parentHash", s.parent_hash);
+
+    s.transactions.clear();
+    const auto txs_it = j.find("transactions");
+    if (txs_it != j.end())
+    {
+      for (const auto& tx_hash : *txs_it)
+      {
+        s.transactions.push_back(hex::to_uint256(tx_hash));
+      }
+    }
+  }
+
+  // Found by ADL through BlockHeader, so must be in this namespace rather
+  // than rpcresults
+  inline void to_json(nlohmann::json& j, const rpcresults::BlockResponse& s)
+  {
+    if (!s.has_value())
+    {
+      j = nullptr;
+    }
+    else
+    {
+      j = s.value();
+    }
+  }
+
+  inline void from_json(const nlohmann::json& j, rpcresults::BlockResponse& s)
+  {
+    if (j.is_null())
+    {
+      s = std::nullopt;
+    }
+    else
+    {
+      s = j.get<BlockHeader>();
+    }
+  }
+
+  //
+  inline void to_json(nlohmann::json& j, const AccessListEntry& s)
+  {
+    j = nlohmann::json::object();
+    j["address"] = keccak::to_checksum_address(s.address);
+
+    auto j_keys = nlohmann::json::array();
+    for (const auto& key : s.storage_keys)
+    {
+      j_keys.push_back(hex::to_hex_string_fixed(key));
+    }
+    j["storageKeys"] = j_keys;
+  }
+
+  inline void from_json(const nlohmann::json& j, AccessListEntry& s)
+  {
+    require_object(j);
+
+    s.address = hex::to_uint256(j["address"]);
+
+    s.storage_keys.clear();
+    for (const auto& key : j["storageKeys"])
+    {
+      s.storage_keys.push_back(hex::to_uint256(key));
+    }
   }
 
   namespace rpcparams
@@ -95,20 +158,20 @@ namespace evm4ccf
     {
       j = nlohmann::json::object();
 
-      j["from"] = eevm::to_checksum_address(s.from);
+      j["from"] = keccak::to_checksum_address(s.from);
 
       if (s.to.has_value())
       {
-        j["to"] = eevm::to_checksum_address(s.to.value());
+        j["to"] = keccak::to_checksum_address(s.to.value());
       }
       else
       {
         j["to"] = nullptr;
       }
 
-      j["gas"] = eevm::to_hex_string(s.gas);
-      j["gasPrice"] = eevm::to_hex_string(s.gas_price);
-      j["value"] = eevm::to_hex_string(s.value);
+      j["gas"] = hex::to_hex_string(s.gas);
+      j["gasPrice"] = hex::to_hex_string(s.gas_price);
+      j["value"] = hex::to_hex_string(s.value);
       j["data"] = s.data;
 
       if (s.private_for.has_value())
@@ -116,17 +179,23 @@ namespace evm4ccf
         auto j_for = nlohmann::json::array();
         for (const auto& a : s.private_for.value())
         {
-          j_for.push_back(eevm::to_checksum_address(a));
+          j_for.push_back(keccak::to_checksum_address(a));
         }
         j["privateFor"] = j_for;
       }
+
+      if (s.type != legacy_transaction_type)
+      {
+        j["type"] = hex::to_hex_string(s.type);
+        j["accessList"] = s.access_list;
+      }
     }
 
     inline void from_json(const nlohmann::json& j, MessageCall& s)
     {
       require_object(j);
 
-      s.from = eevm::to_uint256(j["from"]);
+      s.from = hex::to_uint256(j["from"]);
       from_optional_hex_str(j, "to", s.to);
       from_optional_hex_str(j, "gas", s.gas);
       from_optional_hex_str(j, "gasPrice", s.gas_price);
@@ -151,32 +220,79 @@ namespace evm4ccf
         s.private_for = ContractParticipants();
         for (const auto& a : *private_for_it)
         {
-          s.private_for->insert(eevm::to_uint256(a));
+          s.private_for->insert(hex::to_uint256(a));
         }
       }
+
+      // A call which names an access list, even an empty one, is an EIP-2930
+      // transaction unless it gives another type explicitly
+      const auto access_list_it = j.find("accessList");
+      if (access_list_it != j.end())
+      {
+        s.access_list = access_list_it->get<AccessList>();
+        s.type = access_list_transaction_type;
+      }
+
+      uint256_t type = s.type;
+      from_optional_hex_str(j, "type", type);
+      if (type > uint256_t(access_list_transaction_type))
+      {
+        throw std::invalid_argument(fmt::format(
+          "Unsupported transaction type {}", hex::to_hex_string(type)));
+      }
+      s.type = static_cast<uint8_t>(type);
+
+      if (s.type == legacy_transaction_type && !s.access_list.empty())
+      {
+        throw std::invalid_argument(
+          "Legacy transactions cannot carry an access list");
+      }
     }
 
     //
     inline void to_json(nlohmann::json& j, const AddressWithBlock& s)
     {
       j = nlohmann::json::array();
-      j.push_back(eevm::to_checksum_address(s.address));
+      j.push_back(keccak::to_checksum_address(s.address));
       j.push_back(s.block_id);
     }
 
     inline void from_json(const nlohmann::json& j, AddressWithBlock& s)
     {
       require_array(j);
-      s.address = eevm::to_uint256(j[0]);
+      s.address = hex::to_uint256(j[0]);
       s.block_id = j[1];
     }
 
     //
+    // The object of options which may follow a transaction's params
+    inline void options_to_json(nlohmann::json& j, bool trace)
+    {
+      if (trace)
+      {
+        j.push_back({{"trace", true}});
+      }
+    }
+
+    inline void options_from_json(
+      const nlohmann::json& j, size_t index, bool& trace)
+    {
+      if (j.size() <= index)
+      {
+        return;
+      }
+
+      const auto& options = j[index];
+      require_object(options);
+      trace = options.value("trace", false);
+    }
+
     inline void to_json(nlohmann::json& j, const Call& s)
     {
       j = nlohmann::json::array();
       j.push_back(s.call_data);
       j.push_back(s.block_id);
+      options_to_json(j, s.trace);
     }
 
     inline void from_json(const nlohmann::json& j, Call& s)
@@ -184,34 +300,50 @@ namespace evm4ccf
       require_array(j);
       s.call_data = j[0];
       s.block_id = j[1];
+      options_from_json(j, 2, s.trace);
     }
 
     //
     inline void to_json(nlohmann::json& j, const GetTransactionCount& s)
     {
       j = nlohmann::json::array();
-      j.push_back(eevm::to_checksum_address(s.address));
+      j.push_back(keccak::to_checksum_address(s.address));
       j.push_back(s.block_id);
     }
 
     inline void from_json(const nlohmann::json& j, GetTransactionCount& s)
     {
       require_array(j);
-      s.address = eevm::to_uint256(j[0]);
+      s.address = hex::to_uint256(j[0]);
       s.block_id = j[1];
     }
 
+    //
+    inline void to_json(nlohmann::json& j, const GetBlockByNumber& s)
+    {
+      j = nlohmann::json::array();
+      j.push_back(s.block_id);
+      j.push_back(s.full_transactions);
+    }
+
+    inline void from_json(const nlohmann::json& j, GetBlockByNumber& s)
+    {
+      require_array(j);
+      s.block_id = j[0];
+      s.full_transactions = j[1];
+    }
+
     //
     inline void to_json(nlohmann::json& j, const GetTransactionReceipt& s)
     {
       j = nlohmann::json::array();
-      j.push_back(eevm::to_hex_string(s.tx_hash));
+      j.push_back(hex::to_hex_string(s.tx_hash));
     }
 
     inline void from_json(const nlohmann::json& j, GetTransactionReceipt& s)
     {
       require_array(j);
-      s.tx_hash = eevm::to_uint256(j[0]);
+      s.tx_hash = hex::to_uint256(j[0]);
     }
 
     //
@@ -219,12 +351,14 @@ namespace evm4ccf
     {
       j = nlohmann::json::array();
       j.push_back(s.call_data);
+      options_to_json(j, s.trace);
     }
 
     inline void from_json(const nlohmann::json& j, SendTransaction& s)
     {
       require_array(j);
       s.call_data = j[0];
+      options_from_json(j, 1, s.trace);
     }
 
     //
@@ -232,12 +366,46 @@ namespace evm4ccf
     {
       j = nlohmann::json::array();
       j.push_back(s.raw_transaction);
+      options_to_json(j, s.trace);
     }
 
     inline void from_json(const nlohmann::json& j, SendRawTransaction& s)
     {
       require_array(j);
       s.raw_transaction = j[0];
+      options_from_json(j, 1, s.trace);
+    }
+
+    //
+    inline void to_json(nlohmann::json& j, const SetTracing& s)
+    {
+      j = nlohmann::json::object();
+      j["sampleEvery"] = s.sample_every;
+      j["tailLength"] = s.tail_length;
+
+      auto j_addresses = nlohmann::json::array();
+      for (const auto& a : s.addresses)
+      {
+        j_addresses.push_back(keccak::to_checksum_address(a));
+      }
+      j["addresses"] = j_addresses;
+    }
+
+    inline void from_json(const nlohmann::json& j, SetTracing& s)
+    {
+      require_object(j);
+
+      s.sample_every = j.value("sampleEvery", s.sample_every);
+      s.tail_length = j.value("tailLength", s.tail_length);
+
+      const auto addresses_it = j.find("addresses");
+      if (addresses_it != j.end())
+      {
+        for (const auto& a : *addresses_it)
+        {
+          s.addresses.insert(hex::to_uint256(a));
+        }
+      }
     }
   } // namespace rpcparams
 
@@ -254,33 +422,33 @@ namespace evm4ccf
       {
         j = nlohmann::json::object();
 
-        j["transactionHash"] = eevm::to_hex_string_fixed(s->transaction_hash);
-        j["transactionIndex"] = eevm::to_hex_string(s->transaction_index);
-        j["blockHash"] = eevm::to_hex_string_fixed(s->block_hash);
-        j["blockNumber"] = eevm::to_hex_string(s->block_number);
-        j["from"] = eevm::to_checksum_address(s->from);
+        j["transactionHash"] = hex::to_hex_string_fixed(s->transaction_hash);
+        j["transactionIndex"] = hex::to_hex_string(s->transaction_index);
+        j["blockHash"] = hex::to_hex_string_fixed(s->block_hash);
+        j["blockNumber"] = hex::to_hex_string(s->block_number);
+        j["from"] = keccak::to_checksum_address(s->from);
         if (s->to.has_value())
         {
-          j["to"] = eevm::to_checksum_address(s->to.value());
+          j["to"] = keccak::to_checksum_address(s->to.value());
         }
         else
         {
           j["to"] = nullptr;
         }
-        j["cumulativeGasUsed"] = eevm::to_hex_string(s->cumulative_gas_used);
-        j["gasUsed"] = eevm::to_hex_string(s->gas_used);
+        j["cumulativeGasUsed"] = hex::to_hex_string(s->cumulative_gas_used);
+        j["gasUsed"] = hex::to_hex_string(s->gas_used);
         if (s->contract_address.has_value())
         {
           j["contractAddress"] =
-            eevm::to_checksum_address(s->contract_address.value());
+            keccak::to_checksum_address(s->contract_address.value());
         }
         else
         {
           j["contractAddress"] = nullptr;
         }
         j["logs"] = s->logs;
-        j["logsBloom"] = eevm::to_hex_string(s->logs_bloom);
-        j["status"] = eevm::to_hex_string(s->status);
+        j["logsBloom"] = hex::to_hex_string(s->logs_bloom);
+        j["status"] = hex::to_hex_string(s->status);
       }
     }
 
@@ -295,18 +463,18 @@ namespace evm4ccf
         require_object(j);
 
         s.emplace();
-        s->transaction_hash = eevm::to_uint256(j["transactionHash"]);
-        s->transaction_index = eevm::to_uint256(j["transactionIndex"]);
-        s->block_hash = eevm::to_uint256(j["blockHash"]);
-        s->block_number = eevm::to_uint256(j["blockNumber"]);
-        s->from = eevm::to_uint256(j["from"]);
+        s->transaction_hash = hex::to_uint256(j["transactionHash"]);
+        s->transaction_index = hex::to_uint256(j["transactionIndex"]);
+        s->block_hash = hex::to_uint256(j["blockHash"]);
+        s->block_number = hex::to_uint256(j["blockNumber"]);
+        s->from = hex::to_uint256(j["from"]);
         from_optional_hex_str(j, "to", s->to);
-        s->cumulative_gas_used = eevm::to_uint256(j["cumulativeGasUsed"]);
-        s->gas_used = eevm::to_uint256(j["gasUsed"]);
+        s->cumulative_gas_used = hex::to_uint256(j["cumulativeGasUsed"]);
+        s->gas_used = hex::to_uint256(j["gasUsed"]);
         from_optional_hex_str(j, "contractAddress", s->contract_address);
         s->logs = j["logs"].get<decltype(s->logs)>();
         array_from_hex_string(s->logs_bloom, j["logsBloom"]);
-        s->status = eevm::to_uint256(j["status"]);
+        s->status = hex::to_uint256(j["status"]);
       }
     }
   } // namespace rpcresults
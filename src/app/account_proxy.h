@@ -3,14 +3,27 @@
 #pragma once
 
 // EVM-for-CCF
+#include "arena.h"
+#include "state_history.h"
 #include "tables.h"
 
 // eEVM
 #include <eEVM/account.h>
 #include <eEVM/storage.h>
 
+// STL/3rd-party
+#include <map>
+
 namespace evm4ccf
 {
+  // Storage slots held in memory by an account proxy, allocated from the
+  // arena of the state that owns the proxy
+  using StorageCache = std::map<
+    uint256_t,
+    uint256_t,
+    std::less<uint256_t>,
+    ArenaAllocator<std::pair<const uint256_t, uint256_t>>>;
+
   // This implements both eevm::Account and eevm::Storage via ccf's KV
   struct AccountProxy : public eevm::Account, public eevm::Storage
   {
@@ -18,15 +31,32 @@ namespace evm4ccf
     mutable tables::Accounts::Views accounts_views;
     tables::Storage::TxView& storage;
 
+    // If set, every write is also added to the version history
+    history::Recorder* recorder;
+
+    // Values this proxy has read from or written to the KV. Each is looked up
+    // at most once per transaction, and can be loaded ahead of execution by
+    // prefetch()
+    mutable std::optional<uint256_t> cached_balance = std::nullopt;
+    mutable std::optional<Nonce> cached_nonce = std::nullopt;
+    mutable std::optional<eevm::Code> cached_code = std::nullopt;
+    StorageCache cached_storage;
+
     AccountProxy(
       const eevm::Address& a,
       const tables::Accounts::Views& av,
-      tables::Storage::TxView& st) :
+      tables::Storage::TxView& st,
+      history::Recorder* r = nullptr,
+      Arena* arena = nullptr) :
       address(a),
       accounts_views(av),
-      storage(st)
+      storage(st),
+      recorder(r),
+      cached_storage(arena)
     {}
 
+    virtual ~AccountProxy() = default;
+
     // Implementation of eevm::Account
     eevm::Address get_address() const override
     {
@@ -35,34 +65,62 @@ namespace evm4ccf
 
     uint256_t get_balance() const override
     {
-      return accounts_views.balances->get(address).value_or(0);
+      if (!cached_balance.has_value())
+      {
+        cached_balance = accounts_views.balances->get(address).value_or(0);
+      }
+      return *cached_balance;
     }
 
     void set_balance(const uint256_t& b) override
     {
+      if (recorder != nullptr)
+      {
+        recorder->balance(address, get_balance());
+      }
       accounts_views.balances->put(address, b);
+      cached_balance = b;
     }
 
     Nonce get_nonce() const override
     {
-      return accounts_views.nonces->get(address).value_or(0);
+      if (!cached_nonce.has_value())
+      {
+        cached_nonce = accounts_views.nonces->get(address).value_or(0);
+      }
+      return *cached_nonce;
     }
 
     void increment_nonce() override
     {
-      auto nonce = get_nonce();
-      ++nonce;
+      const auto previous = get_nonce();
+      const auto nonce = previous + 1;
+      if (recorder != nullptr)
+      {
+        recorder->nonce(address, previous);
+      }
       accounts_views.nonces->put(address, nonce);
+      cached_nonce = nonce;
     }
 
     eevm::Code get_code() const override
     {
-      return accounts_views.codes->get(address).value_or(eevm::Code{});
+      if (!cached_code.has_value())
+      {
+        cached_code =
+          accounts_views.codes->get(address).value_or(eevm::Code{});
+      }
+      return *cached_code;
     }
 
     void set_code(eevm::Code&& c) override
     {
+      if (recorder != nullptr)
+      {
+        recorder->code(address, get_code());
+      }
       accounts_views.codes->put(address, c);
+      cached_code = std::move(c);
     }
 
     // Implementation of eevm::Storage
@@ -74,18 +132,143 @@ namespace evm4ccf
     // SNIPPET_START: store_impl
     void store(const uint256_t& key, const uint256_t& value) override
     {
+      if (recorder != nullptr)
+      {
+        recorder->storage(translate(key), load(key));
+      }
       storage.put(translate(key), value);
+      cached_storage[key] = value;
     }
     // SNIPPET_END: store_impl
 
     uint256_t load(const uint256_t& key) override
     {
-      return storage.get(translate(key)).value_or(0);
+      auto it = cached_storage.find(key);
+      if (it == cached_storage.end())
+      {
+        it = cached_storage
+               .emplace(key, storage.get(translate(key)).value_or(0))
+               .first;
+      }
+      return it->second;
     }
 
     bool remove(const uint256_t& key) override
     {
+      if (recorder != nullptr)
+      {
+        recorder->storage(translate(key), load(key));
+      }
+      cached_storage[key] = 0;
       return storage.remove(translate(key));
     }
+
+    // Reads the account and the given storage slots into the caches, so that
+    // execution does not interleave KV lookups with interpretation
+    void prefetch(const std::vector<uint256_t>& keys)
+    {
+      get_balance();
+      get_nonce();
+      get_code();
+      for (const auto& key : keys)
+      {
+        load(key);
+      }
+    }
+  };
+
+  // Reads an account as it was at the end of a past block. Writes made while
+  // executing against past state are held here, and never reach the KV
+  struct HistoricalAccountProxy : public AccountProxy
+  {
+    history::PastState past;
+
+    std::optional<uint256_t> balance = std::nullopt;
+    std::optional<Nonce> nonce = std::nullopt;
+    std::optional<eevm::Code> code = std::nullopt;
+    StorageCache stored;
+
+    HistoricalAccountProxy(
+      const eevm::Address& a,
+      const tables::Accounts::Views& av,
+      tables::Storage::TxView& st,
+      const history::PastState& p,
+      Arena* arena = nullptr) :
+      AccountProxy(a, av, st, nullptr, arena),
+      past(p),
+      stored(arena)
+    {}
+
+    uint256_t get_balance() const override
+    {
+      if (balance.has_value())
+      {
+        return *balance;
+      }
+      return history::read_at(past.views.balances, address, past, [this]() {
+        return AccountProxy::get_balance();
+      });
+    }
+
+    void set_balance(const uint256_t& b) override
+    {
+      balance = b;
+    }
+
+    Nonce get_nonce() const override
+    {
+      if (nonce.has_value())
+      {
+        return *nonce;
+      }
+      return history::read_at(past.views.nonces, address, past, [this]() {
+        return AccountProxy::get_nonce();
+      });
+    }
+
+    void increment_nonce() override
+    {
+      nonce = get_nonce() + 1;
+    }
+
+    eevm::Code get_code() const override
+    {
+      if (code.has_value())
+      {
+        return *code;
+      }
+      return history::read_at(past.views.codes, address, past, [this]() {
+        return AccountProxy::get_code();
+      });
+    }
+
+    void set_code(eevm::Code&& c) override
+    {
+      code = std::move(c);
+    }
+
+    void store(const uint256_t& key, const uint256_t& value) override
+    {
+      stored[key] = value;
+    }
+
+    uint256_t load(const uint256_t& key) override
+    {
+      const auto it = stored.find(key);
+      if (it != stored.end())
+      {
+        return it->second;
+      }
+      return history::read_at(
+        past.views.storage, translate(key), past, [this, &key]() {
+          return AccountProxy::load(key);
+        });
+    }
+
+    bool remove(const uint256_t& key) override
+    {
+      stored[key] = 0;
+      return true;
+    }
   };
 } // namespace evm4ccf
@@ -0,0 +1,230 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#pragma once
+
+// STL/3rd-party
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+// Monotonic arena for objects which all die together, such as the account
+// proxies and storage caches built while handling a single request.
+// Allocation bumps a pointer through an inline buffer, then through heap
+// blocks of doubling size once that is full. Nothing is freed until the arena
+// is destroyed, when all of its memory is released in one step. Heap blocks
+// come from a per-thread pool and are returned to it, so that once a thread
+// has handled a few requests, later requests of a similar size reuse the
+// same blocks rather than allocating.
+namespace evm4ccf
+{
+  // Heap blocks released by arenas, for reuse by later arenas on the same
+  // thread. Bounded, so that one unusually large request does not keep its
+  // memory for the life of the thread
+  class BlockPool
+  {
+  public:
+    static constexpr size_t max_blocks = 16;
+    static constexpr size_t max_bytes = 1024 * 1024;
+
+    struct Block
+    {
+      std::unique_ptr<uint8_t[]> data;
+      size_t size;
+    };
+
+  private:
+    std::vector<Block> free_blocks;
+    size_t free_bytes = 0;
+
+    size_t allocated_blocks = 0;
+    size_t reused_blocks = 0;
+
+  public:
+    BlockPool() = default;
+    BlockPool(const BlockPool&) = delete;
+    BlockPool& operator=(const BlockPool&) = delete;
+
+    // The smallest free block of at least min_size bytes, or a new block of
+    // exactly min_size bytes if there is none
+    Block take(size_t min_size)
+    {
+      auto best = free_blocks.end();
+      for (auto it = free_blocks.begin(); it != free_blocks.end(); ++it)
+      {
+        if (
+          it->size >= min_size &&
+          (best == free_blocks.end() || it->size < best->size))
+        {
+          best = it;
+        }
+      }
+
+      if (best == free_blocks.end())
+      {
+        ++allocated_blocks;
+        return {std::unique_ptr<uint8_t[]>(new uint8_t[min_size]), min_size};
+      }
+
+      ++reused_blocks;
+      Block block = std::move(*best);
+      *best = std::move(free_blocks.back());
+      free_blocks.pop_back();
+      free_bytes -= block.size;
+      return block;
+    }
+
+    // Keeps a block for reuse, or frees it if the pool is full
+    void give(Block block)
+    {
+      if (
+        free_blocks.size() == max_blocks ||
+        free_bytes + block.size > max_bytes)
+      {
+        return;
+      }
+
+      free_bytes += block.size;
+      free_blocks.push_back(std::move(block));
+    }
+
+    // Number of blocks this pool has had to allocate, the number it has
+    // handed out again, and the number it holds for reuse
+    size_t get_allocated_blocks() const
+    {
+      return allocated_blocks;
+    }
+
+    size_t get_reused_blocks() const
+    {
+      return reused_blocks;
+    }
+
+    size_t get_free_blocks() const
+    {
+      return free_blocks.size();
+    }
+
+    // The pool used by arenas created on this thread
+    static BlockPool& local()
+    {
+      thread_local BlockPool pool;
+      return pool;
+    }
+  };
+
+  // An arena takes its blocks from a pool which is not synchronised, so it
+  // must be destroyed on the thread that created it
+  class Arena
+  {
+  public:
+    static constexpr size_t inline_size = 4096;
+
+  private:
+    alignas(std::max_align_t) uint8_t initial[inline_size];
+    uint8_t* current = initial;
+    size_t remaining = inline_size;
+    size_t next_block_size = 2 * inline_size;
+    BlockPool& pool;
+    std::vector<BlockPool::Block> blocks;
+
+    size_t allocations = 0;
+
+  public:
+    Arena(BlockPool& pool = BlockPool::local()) : pool(pool) {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena()
+    {
+      for (auto& block : blocks)
+      {
+        pool.give(std::move(block));
+      }
+    }
+
+    void* allocate(size_t size, size_t alignment)
+    {
+      auto p = reinterpret_cast<uintptr_t>(current);
+      auto padding = (alignment - p % alignment) % alignment;
+      if (padding + size > remaining)
+      {
+        const auto block_size = std::max(next_block_size, size + alignment);
+        blocks.push_back(pool.take(block_size));
+        current = blocks.back().data.get();
+        remaining = blocks.back().size;
+        next_block_size = 2 * block_size;
+
+        p = reinterpret_cast<uintptr_t>(current);
+        padding = (alignment - p % alignment) % alignment;
+      }
+
+      current += padding + size;
+      remaining -= padding + size;
+      ++allocations;
+      return reinterpret_cast<void*>(p + padding);
+    }
+
+    // Number of allocations served, and how many heap blocks were needed to
+    // serve them
+    size_t get_allocations() const
+    {
+      return allocations;
+    }
+
+    size_t get_heap_blocks() const
+    {
+      return blocks.size();
+    }
+  };
+
+  // STL allocator which takes memory from an Arena, and never frees it. A
+  // default-constructed allocator has no arena and uses the heap, so that
+  // containers using it can still be built outside a request.
+  template <typename T>
+  struct ArenaAllocator
+  {
+    using value_type = T;
+
+    Arena* arena = nullptr;
+
+    ArenaAllocator() noexcept = default;
+    ArenaAllocator(Arena* a) noexcept : arena(a) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept :
+      arena(other.arena)
+    {}
+
+    T* allocate(size_t n)
+    {
+      if (arena == nullptr)
+      {
+        return std::allocator<T>().allocate(n);
+      }
+      return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, size_t n) noexcept
+    {
+      if (arena == nullptr)
+      {
+        std::allocator<T>().deallocate(p, n);
+      }
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const noexcept
+    {
+      return arena == other.arena;
+    }
+
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const noexcept
+    {
+      return arena != other.arena;
+    }
+  };
+} // namespace evm4ccf
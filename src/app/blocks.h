@@ -0,0 +1,210 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#pragma once
+
+// EVM-for-CCF
+#include "keccak256.h"
+#include "tables.h"
+
+// eEVM
+#include <eEVM/util.h>
+
+namespace evm4ccf
+{
+  // Committed transactions are grouped into pseudo-blocks, so that clients can
+  // sync by block range. A block is sealed once it holds a fixed number of
+  // transactions. Every write transaction updates the pending block, so
+  // transactions are serialised on it, but CCF already executes them in order.
+  //
+  // The hash is not an Ethereum header hash. It commits to the parent block,
+  // the block number and the block's transactions, in order.
+  inline BlockHash compute_block_hash(const BlockHeader& block)
+  {
+    uint8_t word[32];
+    keccak::Hasher hasher;
+
+    eevm::to_big_endian(block.parent_hash, word);
+    hasher.update(word, sizeof(word));
+
+    eevm::to_big_endian(block.number, word);
+    hasher.update(word, sizeof(word));
+
+    for (const auto& tx_hash : block.transactions)
+    {
+      eevm::to_big_endian(tx_hash, word);
+      hasher.update(word, sizeof(word));
+    }
+
+    return eevm::from_big_endian(hasher.finalize().data());
+  }
+
+  // Block 0 is an empty genesis block, so that there is always a latest
+  // block. It is not stored, and transactions are sealed into blocks from 1
+  // onwards
+  inline const BlockHeader& genesis_block()
+  {
+    static const BlockHeader genesis = []() {
+      BlockHeader block;
+      block.block_hash = compute_block_hash(block);
+      return block;
+    }();
+    return genesis;
+  }
+
+  // Returns nullopt if the block has not been sealed yet
+  inline std::optional<BlockHeader> get_sealed_block(
+    tables::Blocks::TxView* blocks, uint64_t number)
+  {
+    if (number == 0)
+    {
+      return genesis_block();
+    }
+    return blocks->get(number);
+  }
+
+  class BlockBuilder
+  {
+    tables::Blocks::TxView* blocks;
+    tables::PendingBlock::TxView* pending;
+
+  public:
+    BlockBuilder(
+      tables::Blocks::TxView* blocks, tables::PendingBlock::TxView* pending) :
+      blocks(blocks),
+      pending(pending)
+    {}
+
+    BlockHeader get_pending() const
+    {
+      const auto block = pending->get(tables::pending_block_key);
+      if (block.has_value())
+      {
+        return *block;
+      }
+
+      BlockHeader first;
+      first.number = 1;
+      first.parent_hash = genesis_block().block_hash;
+      return first;
+    }
+
+    // Number of the most recently sealed block, which is the genesis block
+    // until the first transaction's block is sealed
+    uint64_t latest_number() const
+    {
+      return get_pending().number - 1;
+    }
+
+    std::optional<BlockHeader> get_sealed(uint64_t number) const
+    {
+      return get_sealed_block(blocks, number);
+    }
+
+    // Resolves an Ethereum default block parameter: "earliest", "latest",
+    // "pending", or a hex-encoded block number
+    uint64_t get_number(const BlockID& block_id) const
+    {
+      if (block_id == "earliest")
+      {
+        return 0;
+      }
+
+      if (block_id == "latest")
+      {
+        return latest_number();
+      }
+
+      if (block_id == "pending")
+      {
+        return get_pending().number;
+      }
+
+      if (!hex::has_prefix(block_id))
+      {
+        throw std::invalid_argument(fmt::format(
+          "Block parameter should be 'earliest', 'latest', 'pending' or a "
+          "hex-encoded number, not '{}'",
+          block_id));
+      }
+
+      return eevm::to_uint64(block_id);
+    }
+
+    // Returns nullopt if the block has not been sealed yet
+    std::optional<BlockHeader> get_by_id(const BlockID& block_id) const
+    {
+      if (block_id == "pending")
+      {
+        return get_pending();
+      }
+
+      return get_sealed(get_number(block_id));
+    }
+
+    // Adds a transaction to the pending block, sealing the block if it is
+    // then full. Returns the block number and the transaction's index in it
+    std::pair<uint64_t, uint64_t> add_transaction(
+      const TxHash& tx_hash, size_t transactions_per_block)
+    {
+      auto block = get_pending();
+
+      const auto number = block.number;
+      const auto index = block.transactions.size();
+      block.transactions.push_back(tx_hash);
+
+      if (block.transactions.size() >= transactions_per_block)
+      {
+        block.block_hash = compute_block_hash(block);
+        blocks->put(block.number, block);
+
+        BlockHeader next;
+        next.number = block.number + 1;
+        next.parent_hash = block.block_hash;
+        pending->put(tables::pending_block_key, next);
+      }
+      else
+      {
+        pending->put(tables::pending_block_key, block);
+      }
+
+      return std::make_pair(number, index);
+    }
+  };
+
+  // Results are only kept in eth.txresults for the transactions of the most
+  // recent sealed blocks. Once block number `sealed` has been sealed, this
+  // moves the results of the block which has just left the retention window
+  // into the archive, in their compact encoding. A retention of 0 keeps every
+  // result live. Returns the number of results archived
+  inline size_t evict_results(
+    const BlockBuilder& builder,
+    tables::Results::TxView* results,
+    tables::ArchivedResults::TxView* archive,
+    uint64_t sealed,
+    uint64_t retention)
+  {
+    if (retention == 0 || sealed < retention)
+    {
+      return 0;
+    }
+
+    const auto block = builder.get_sealed(sealed - retention);
+    if (!block.has_value())
+    {
+      return 0;
+    }
+
+    size_t archived = 0;
+    for (const auto& tx_hash : block->transactions)
+    {
+      const auto result = results->get(tx_hash);
+      if (result.has_value())
+      {
+        archive->put(tx_hash, receipts::encode(*result));
+        results->remove(tx_hash);
+        ++archived;
+      }
+    }
+    return archived;
+  }
+} // namespace evm4ccf
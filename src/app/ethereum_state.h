@@ -3,6 +3,9 @@
 #pragma once
 
 // EVM-for-CCF
+#include "account_proxy.h"
+#include "blocks.h"
+#include "keccak256.h"
 #include "tables.h"
 
 // CCF
@@ -25,35 +28,113 @@ namespace evm4ccf
 
     tables::Accounts::Views accounts;
     tables::Storage::TxView& tx_storage;
+    tables::Blocks::TxView* blocks;
 
-    std::map<eevm::Address, std::unique_ptr<AccountProxy>> cache;
+    std::optional<history::Recorder> recorder;
+    std::optional<history::PastState> past;
 
-    eevm::AccountState add_to_cache(const eevm::Address& address)
+    // The state lives for a single request. The proxies it creates, their
+    // storage caches and the cache of proxies are allocated from this arena,
+    // and are all released together when the state is destroyed
+    Arena arena;
+
+    using Cache = std::map<
+      eevm::Address,
+      AccountProxy*,
+      std::less<eevm::Address>,
+      ArenaAllocator<std::pair<const eevm::Address, AccountProxy*>>>;
+    Cache cache{&arena};
+
+    template <typename T, typename... Ts>
+    AccountProxy* make_in_arena(Ts&&... ts)
+    {
+      void* p = arena.allocate(sizeof(T), alignof(T));
+      return new (p) T(std::forward<Ts>(ts)...);
+    }
+
+    AccountProxy* make_proxy(const eevm::Address& address)
     {
-      auto ib = cache.insert(std::make_pair(
+      if (past.has_value())
+      {
+        return make_in_arena<HistoricalAccountProxy>(
+          address, accounts, tx_storage, *past, &arena);
+      }
+
+      return make_in_arena<AccountProxy>(
         address,
-        std::make_unique<AccountProxy>(address, accounts, tx_storage)));
+        accounts,
+        tx_storage,
+        recorder.has_value() ? &*recorder : nullptr,
+        &arena);
+    }
 
-      if (!ib.second)
+    eevm::AccountState add_to_cache(const eevm::Address& address)
+    {
+      if (cache.find(address) != cache.end())
       {
         throw std::logic_error(fmt::format(
           "Added account proxy to cache at address {}, but an "
           "entry already existed",
-          eevm::to_checksum_address(address)));
+          keccak::to_checksum_address(address)));
       }
 
-      auto& proxy = ib.first->second;
+      auto proxy = cache.emplace(address, make_proxy(address)).first->second;
       return eevm::AccountState(*proxy, *proxy);
     }
 
   public:
+    // With a recorder, writes are added to the version history. With a past
+    // state, reads see the end of that block and writes stay in memory
     template <typename... Ts>
     EthereumState(
       const tables::Accounts::Views& acc_views,
-      tables::Storage::TxView* views) :
+      tables::Storage::TxView* views,
+      tables::Blocks::TxView* blocks_view = nullptr,
+      uint64_t block_number = 0,
+      std::optional<history::Recorder> history_recorder = std::nullopt,
+      std::optional<history::PastState> past_state = std::nullopt) :
       accounts(acc_views),
-      tx_storage(*views)
-    {}
+      tx_storage(*views),
+      blocks(blocks_view),
+      recorder(std::move(history_recorder)),
+      past(std::move(past_state))
+    {
+      current_block.number = past.has_value() ? past->block : block_number;
+    }
+
+    EthereumState(const EthereumState&) = delete;
+    EthereumState& operator=(const EthereumState&) = delete;
+
+    // The arena frees the proxies' memory, but not what they own themselves
+    ~EthereumState()
+    {
+      for (auto& [address, proxy] : cache)
+      {
+        proxy->~AccountProxy();
+      }
+    }
+
+    // Number of allocations made from this state's arena, and the number of
+    // heap blocks it needed to make them
+    size_t get_arena_allocations() const
+    {
+      return arena.get_allocations();
+    }
+
+    size_t get_arena_heap_blocks() const
+    {
+      return arena.get_heap_blocks();
+    }
+
+    // Stores the keys written through this state in the version history, once
+    // the transaction's index in its block is known
+    void write_history_delta(uint64_t transaction_index)
+    {
+      if (recorder.has_value())
+      {
+        recorder->write_delta(transaction_index);
+      }
+    }
 
     void remove(const eevm::Address& addr) override
     {
@@ -70,9 +151,12 @@ namespace evm4ccf
         return eevm::AccountState(*proxy, *proxy);
       }
 
-      // If account doesn't already exist, it should be created
+      // If account doesn't already exist, it should be created. Past state
+      // lacks the accounts created since its block
       const auto kind_it = accounts.balances->get(address);
-      if (!kind_it.has_value())
+      if (
+        !kind_it.has_value() ||
+        (past.has_value() && !history::existed_at(address, *past)))
       {
         return create(address, 0, {});
       }
@@ -93,16 +177,34 @@ namespace evm4ccf
         initial_nonce = 1;
       }
 
+      if (past.has_value())
+      {
+        // Accounts created while executing against past state are never
+        // written to the KV
+        auto state = add_to_cache(address);
+        state.acc.set_balance(balance);
+        state.acc.set_code(eevm::Code(code));
+        if (initial_nonce != 0)
+        {
+          state.acc.increment_nonce();
+        }
+        return state;
+      }
+
       // Write initial balance
       const auto balance_it = accounts.balances->get(address);
       if (balance_it.has_value())
       {
         throw std::logic_error(fmt::format(
           "Trying to create account at {}, but it already has a balance",
-          eevm::to_checksum_address(address)));
+          keccak::to_checksum_address(address)));
       }
       else
       {
+        if (recorder.has_value())
+        {
+          recorder->created(address);
+        }
         accounts.balances->put(address, balance);
       }
 
@@ -112,10 +214,14 @@ namespace evm4ccf
       {
         throw std::logic_error(fmt::format(
           "Trying to create account at {}, but it already has code",
-          eevm::to_checksum_address(address)));
+          keccak::to_checksum_address(address)));
       }
       else
       {
+        if (recorder.has_value())
+        {
+          recorder->code(address, {});
+        }
         accounts.codes->put(address, code);
       }
 
@@ -125,24 +231,70 @@ namespace evm4ccf
       {
         throw std::logic_error(fmt::format(
           "Trying to create account at {}, but it already has a nonce",
-          eevm::to_checksum_address(address)));
+          keccak::to_checksum_address(address)));
       }
       else
       {
+        if (recorder.has_value())
+        {
+          recorder->nonce(address, 0);
+        }
         accounts.nonces->put(address, initial_nonce);
       }
 
       return add_to_cache(address);
     }
 
+    // Loads the accounts and storage slots named by an access list before
+    // execution. Accounts which do not exist yet are skipped rather than
+    // created, and past state is read lazily as before
+    void prefetch(const AccessList& access_list)
+    {
+      if (past.has_value())
+      {
+        return;
+      }
+
+      for (const auto& entry : access_list)
+      {
+        auto cache_it = cache.find(entry.address);
+        if (cache_it == cache.end())
+        {
+          if (!accounts.balances->get(entry.address).has_value())
+          {
+            continue;
+          }
+          add_to_cache(entry.address);
+          cache_it = cache.find(entry.address);
+        }
+
+        cache_it->second->prefetch(entry.storage_keys);
+      }
+    }
+
     const eevm::Block& get_current_block() override
     {
       return current_block;
     }
 
+    // eEVM returns 0 for BLOCKHASH operands of 256 or more, and passes
+    // smaller operands through unchanged as a single byte, so this is an
+    // absolute block number below 256. As in Ethereum, a block is only
+    // visible while it is one of the 256 most recent sealed blocks. Once the
+    // pending block is past 511, every lookup returns 0
     uint256_t get_block_hash(uint8_t offset) override
     {
-      return 0;
+      constexpr uint64_t max_depth = 256;
+      const uint64_t number = offset;
+      if (
+        blocks == nullptr || number >= current_block.number ||
+        current_block.number - number > max_depth)
+      {
+        return 0;
+      }
+
+      const auto header = get_sealed_block(blocks, number);
+      return header.has_value() ? header->block_hash : 0;
     }
   };
 } // namespace evm4ccf
@@ -3,9 +3,16 @@
 
 // EVM-for-CCF
 #include "account_proxy.h"
+#include "blocks.h"
 #include "ethereum_state.h"
 #include "ethereum_transaction.h"
+#include "hex_encoding.h"
+#include "keccak256.h"
+#include "metrics.h"
+#include "opcode_stats.h"
+#include "receipt_logs.h"
 #include "tables.h"
+#include "tracing.h"
 
 // CCF
 #include "ds/hash.h"
@@ -23,6 +30,39 @@
 // STL/3rd-party
 #include <msgpack-c/msgpack.hpp>
 
+#ifndef TRANSACTIONS_PER_BLOCK
+#  define TRANSACTIONS_PER_BLOCK 1
+#endif
+
+#ifndef HISTORY_RETENTION_BLOCKS
+#  define HISTORY_RETENTION_BLOCKS 8192
+#endif
+
+#ifndef RECEIPT_RETENTION_BLOCKS
+#  define RECEIPT_RETENTION_BLOCKS 0
+#endif
+
+// Signed transactions may arrive ahead of their sender's next nonce, and are
+// queued until it is reached. A nonce this far ahead, or further, is rejected
+#ifndef QUEUED_TRANSACTIONS_PER_SENDER
+#  define QUEUED_TRANSACTIONS_PER_SENDER 64
+#endif
+
+// Initial tracing configuration, which applies until settings are stored with
+// evm4ccf_setTracing. RECORD_TRACE traces every execution from startup, and is
+// the only build which writes failing traces to the host's log
+#ifndef TRACE_SAMPLE_EVERY
+#  ifdef RECORD_TRACE
+#    define TRACE_SAMPLE_EVERY 1
+#  else
+#    define TRACE_SAMPLE_EVERY 0
+#  endif
+#endif
+
+#ifndef TRACE_TAIL_LENGTH
+#  define TRACE_TAIL_LENGTH 64
+#endif
+
 namespace evm4ccf
 {
   using namespace std;
@@ -38,10 +78,225 @@ namespace evm4ccf
     tables::Accounts accounts;
     tables::Storage& storage;
     tables::Results& tx_results;
+    tables::ArchivedResults& archived_results;
+    tables::Blocks& blocks;
+    tables::PendingBlock& pending_block;
+    tables::History history;
+    tables::Operators& operators;
+    tables::Tracing& tracing_settings;
+    tables::TransactionQueue transaction_queue;
+
+    const size_t transactions_per_block;
+
+    // Number of recent blocks whose state can be read. 0 disables the
+    // version history
+    const uint64_t history_retention;
+
+    // Number of recent blocks whose transaction results are kept. 0 keeps
+    // every result
+    const uint64_t receipt_retention;
+
+    // Latency of each phase of each RPC handler
+    metrics::Registry method_metrics;
+
+    // Chooses which executions are traced
+    tracing::Sampler trace_sampler;
 
+#ifdef RECORD_OPCODE_STATS
+    // Opcodes executed by each contract, and the time spent executing them
+    opcode_stats::Registry code_stats;
+#endif
+
+    BlockBuilder make_block_builder(Store::Tx& tx)
+    {
+      return BlockBuilder(tx.get_view(blocks), tx.get_view(pending_block));
+    }
+
+    // Current state. Execution sees the pending block as the current block
     EthereumState make_state(Store::Tx& tx)
     {
-      return EthereumState(accounts.get_views(tx), tx.get_view(storage));
+      metrics::Timer t(metrics::Phase::MakeState);
+      const auto pending = make_block_builder(tx).get_pending();
+      return EthereumState(
+        accounts.get_views(tx),
+        tx.get_view(storage),
+        tx.get_view(blocks),
+        pending.number);
+    }
+
+    // Current state, recording every write in the version history
+    EthereumState make_recording_state(Store::Tx& tx)
+    {
+      metrics::Timer t(metrics::Phase::MakeState);
+      const auto pending = make_block_builder(tx).get_pending();
+
+      std::optional<history::Recorder> recorder = std::nullopt;
+      if (history_retention != 0)
+      {
+        recorder.emplace(history.get_views(tx), pending.number);
+      }
+
+      return EthereumState(
+        accounts.get_views(tx),
+        tx.get_view(storage),
+        tx.get_view(blocks),
+        pending.number,
+        std::move(recorder));
+    }
+
+    // State at the end of a past block
+    EthereumState make_state(Store::Tx& tx, uint64_t block)
+    {
+      metrics::Timer t(metrics::Phase::MakeState);
+      return EthereumState(
+        accounts.get_views(tx),
+        tx.get_view(storage),
+        tx.get_view(blocks),
+        block,
+        std::nullopt,
+        history::PastState{history.get_views(tx), block});
+    }
+
+    // Once a block has been sealed, reads can reach back to the state at the
+    // end of the block history_retention blocks before the new pending
+    // block. The history recorded in that block is no longer needed
+    void prune_history(
+      Store::Tx& tx, const BlockBuilder& builder, uint64_t sealed)
+    {
+      if (history_retention == 0 || sealed < history_retention)
+      {
+        return;
+      }
+
+      const auto expired = sealed + 1 - history_retention;
+      const auto block = builder.get_sealed(expired);
+      if (block.has_value())
+      {
+        history::prune(
+          history.get_views(tx), expired, block->transactions.size());
+      }
+    }
+
+    // Resolves the block parameter of a read to a past block, or to nullopt
+    // for the current state
+    std::optional<uint64_t> get_state_block(
+      Store::Tx& tx, const BlockID& block_id)
+    {
+      if (block_id == "latest" || block_id == "pending")
+      {
+        return std::nullopt;
+      }
+
+      const auto builder = make_block_builder(tx);
+      const auto number = builder.get_number(block_id);
+      const auto pending = builder.get_pending().number;
+      if (number >= pending)
+      {
+        throw std::invalid_argument(
+          fmt::format("Block {} has not been sealed", number));
+      }
+
+      if (pending - number > history_retention)
+      {
+        throw std::invalid_argument(fmt::format(
+          "State at block {} is no longer retained. Only the most recent {} "
+          "blocks can be read",
+          number,
+          history_retention));
+      }
+
+      return number;
+    }
+
+    // Calls f with the state requested by a read's block parameter
+    template <typename F>
+    pair<bool, nlohmann::json> with_state_at(
+      Store::Tx& tx, const BlockID& block_id, F&& f)
+    {
+      std::optional<uint64_t> block;
+      try
+      {
+        block = get_state_block(tx, block_id);
+      }
+      catch (const std::invalid_argument& e)
+      {
+        return jsonrpc::error(
+          jsonrpc::StandardErrorCodes::INVALID_PARAMS, e.what());
+      }
+
+      if (block.has_value())
+      {
+        auto es = make_state(tx, *block);
+        return f(es);
+      }
+
+      auto es = make_state(tx);
+      return f(es);
+    }
+
+    // The address an operator transacts from, or nullopt if the caller is not
+    // an operator
+    std::optional<Address> get_operator(Store::Tx& tx, CallerId caller_id)
+    {
+      return tx.get_view(operators)->get(caller_id);
+    }
+
+    // Applies the tracing settings last stored by any node, if this node has
+    // not already
+    void sync_tracing(Store::Tx& tx)
+    {
+      const auto settings =
+        tx.get_view(tracing_settings)->get(tables::tracing_key);
+      if (settings.has_value())
+      {
+        trace_sampler.configure(
+          settings->generation,
+          settings->sample_every,
+          settings->tail_length,
+          settings->addresses);
+      }
+    }
+
+    static pair<bool, nlohmann::json> operators_only(const std::string& method)
+    {
+      return jsonrpc::error(
+        jsonrpc::StandardErrorCodes::INVALID_REQUEST,
+        fmt::format("{} may only be called by an operator", method));
+    }
+
+    template <typename T>
+    static T parse(const nlohmann::json& params)
+    {
+      metrics::Timer t(metrics::Phase::ParseParams);
+      return params;
+    }
+
+    // Installs a handler which runs inside a metrics::MethodScope, so that
+    // its phases are recorded against this method
+    template <typename F>
+    void install_timed(const std::string& method, F f, ReadWrite rw)
+    {
+      auto& m = method_metrics.add(method);
+      if constexpr (std::is_invocable_v<F, RequestArgs&>)
+      {
+        install(
+          method,
+          [&m, f](RequestArgs& args) {
+            metrics::MethodScope scope(m);
+            return f(args);
+          },
+          rw);
+      }
+      else
+      {
+        install(
+          method,
+          [&m, f](Store::Tx& tx, const nlohmann::json& params) {
+            metrics::MethodScope scope(m);
+            return f(tx, params);
+          },
+          rw);
+      }
     }
 
     void install_standard_rpcs()
@@ -49,7 +304,7 @@ namespace evm4ccf
       auto call = [this](RequestArgs& args) {
         CallerId caller_id = args.caller_id;
         Store::Tx& tx = args.tx;
-        ethrpc::Call::Params cp = args.params;
+        const auto cp = parse<ethrpc::Call::Params>(args.params);
 
         if (!cp.call_data.to.has_value())
         {
@@ -57,96 +312,128 @@ namespace evm4ccf
             jsonrpc::StandardErrorCodes::INVALID_PARAMS, "Missing 'to' field");
         }
 
-        auto es = make_state(tx);
-
-        const auto e = run_in_evm(cp.call_data, es).first;
-
-        if (e.er == ExitReason::returned || e.er == ExitReason::halted)
+        MessageCall call_data;
         {
-          // Call should have no effect so we don't commit it.
-          // Just return the result.
-          return jsonrpc::success(to_hex_string(e.output));
+          metrics::Timer t(metrics::Phase::ParseParams);
+          call_data = MessageCall(cp.call_data);
         }
-        else
-        {
-          return jsonrpc::error(
-            jsonrpc::StandardErrorCodes::INTERNAL_ERROR, e.exmsg);
-        }
-      };
 
-      auto get_balance = [this](Store::Tx& tx, const nlohmann::json& params) {
-        rpcparams::AddressWithBlock ab = params;
-        if (ab.block_id != "latest")
-        {
-          return jsonrpc::error(
-            jsonrpc::StandardErrorCodes::INVALID_PARAMS,
-            "Can only request latest block");
-        }
+        sync_tracing(tx);
+        return with_state_at(tx, cp.block_id, [&](EthereumState& es) {
+          const auto e = run_in_evm(call_data, es, cp.trace).first;
 
-        auto es = make_state(tx);
+          if (e.er == ExitReason::returned || e.er == ExitReason::halted)
+          {
+            // Call should have no effect so we don't commit it.
+            // Just return the result.
+            metrics::Timer t(metrics::Phase::SerialiseResponse);
+            return jsonrpc::success(hex::to_hex_string(e.output));
+          }
+          else
+          {
+            return jsonrpc::error(
+              jsonrpc::StandardErrorCodes::INTERNAL_ERROR, e.exmsg);
+          }
+        });
+      };
 
-        const auto account_state = es.get(ab.address);
-        return jsonrpc::success(to_hex_string(account_state.acc.get_balance()));
+      auto get_balance = [this](Store::Tx& tx, const nlohmann::json& params) {
+        const auto ab = parse<rpcparams::AddressWithBlock>(params);
+
+        return with_state_at(tx, ab.block_id, [&](EthereumState& es) {
+          const auto account_state = es.get(ab.address);
+          metrics::Timer t(metrics::Phase::SerialiseResponse);
+          return jsonrpc::success(
+            hex::to_hex_string(account_state.acc.get_balance()));
+        });
       };
 
       auto get_code = [this](Store::Tx& tx, const nlohmann::json& params) {
-        rpcparams::AddressWithBlock ab = params;
-        if (ab.block_id != "latest")
-        {
-          return jsonrpc::error(
-            jsonrpc::StandardErrorCodes::INVALID_PARAMS,
-            "Can only request latest block");
-        }
-
-        auto es = make_state(tx);
-
-        const auto account_state = es.get(ab.address);
-        return jsonrpc::success(to_hex_string(account_state.acc.get_code()));
+        const auto ab = parse<rpcparams::AddressWithBlock>(params);
+
+        return with_state_at(tx, ab.block_id, [&](EthereumState& es) {
+          const auto account_state = es.get(ab.address);
+          metrics::Timer t(metrics::Phase::SerialiseResponse);
+          return jsonrpc::success(
+            hex::to_hex_string(account_state.acc.get_code()));
+        });
       };
 
       auto get_transaction_count =
         [this](Store::Tx& tx, const nlohmann::json& params) {
-          rpcparams::GetTransactionCount gtcp = params;
-          if (gtcp.block_id != "latest")
-          {
-            return jsonrpc::error(
-              jsonrpc::StandardErrorCodes::INVALID_PARAMS,
-              "Can only request latest block");
-          }
+          const auto gtcp = parse<rpcparams::GetTransactionCount>(params);
+
+          return with_state_at(tx, gtcp.block_id, [&](EthereumState& es) {
+            auto account_state = es.get(gtcp.address);
+            size_t nonce = account_state.acc.get_nonce();
 
-          auto es = make_state(tx);
-          auto account_state = es.get(gtcp.address);
+            // The pending count includes the sender's queued transactions
+            if (gtcp.block_id == "pending")
+            {
+              nonce += tx.get_view(transaction_queue.counts)
+                         ->get(gtcp.address)
+                         .value_or(0);
+            }
 
-          return jsonrpc::success(to_hex_string(account_state.acc.get_nonce()));
+            metrics::Timer t(metrics::Phase::SerialiseResponse);
+            return jsonrpc::success(hex::to_hex_string(nonce));
+          });
         };
 
       auto send_raw_transaction = [this](RequestArgs& args) {
-        rpcparams::SendRawTransaction srtp = args.params;
+        const auto srtp = parse<rpcparams::SendRawTransaction>(args.params);
 
-        eevm::rlp::ByteString in = eevm::to_bytes(srtp.raw_transaction);
+        // Decoded in place - the transaction does not outlive this request
+        std::vector<uint8_t> in;
+        const auto eth_tx = [&]() {
+          metrics::Timer t(metrics::Phase::ParseParams);
+          hex::to_bytes(srtp.raw_transaction, in);
+          return SignedTransactionView({in.data(), in.size()});
+        }();
 
-        EthereumTransactionWithSignature eth_tx(in);
-
-        rpcparams::MessageCall tc;
-        eth_tx.to_transaction_call(tc);
+        MessageCall call_data;
+        {
+          metrics::Timer t(metrics::Phase::RecoverSender);
+          eth_tx.to_message_call(call_data);
+        }
 
-        return execute_transaction(args.caller_id, tc, args.tx);
+        return submit_transaction(
+          args.caller_id, call_data, args.tx, eth_tx.nonce, in, srtp.trace);
       };
 
       auto send_transaction = [this](RequestArgs& args) {
-        rpcparams::SendTransaction stp = args.params;
+        const auto stp = parse<rpcparams::SendTransaction>(args.params);
+
+        MessageCall call_data;
+        {
+          metrics::Timer t(metrics::Phase::ParseParams);
+          call_data = MessageCall(stp.call_data);
+        }
 
-        return execute_transaction(args.caller_id, stp.call_data, args.tx);
+        return execute_transaction(
+          args.caller_id, call_data, args.tx, stp.trace);
       };
 
       auto get_transaction_receipt =
         [this](Store::Tx& tx, const nlohmann::json& params) {
-          rpcparams::GetTransactionReceipt gtrp = params;
+          const auto gtrp =
+            parse<rpcparams::GetTransactionReceipt>(params);
 
           const TxHash& tx_hash = gtrp.tx_hash;
 
           auto results_view = tx.get_view(tx_results);
-          const auto r = results_view->get(tx_hash);
+          auto r = results_view->get(tx_hash);
+
+          // Results evicted from the live map are read back from the archive
+          if (!r.has_value())
+          {
+            const auto archived =
+              tx.get_view(archived_results)->get(tx_hash);
+            if (archived.has_value())
+            {
+              r = receipts::decode(*archived);
+            }
+          }
 
           // "or null when no receipt was found"
           rpcresults::ReceiptResponse response = nullopt;
@@ -164,43 +451,195 @@ namespace evm4ccf
             {
               response->to = 0x0;
             }
-            response->logs = tx_result.logs;
+            response->logs = tx_result.logs.to_log_entries();
             response->status = 1;
+
+            response->block_number = tx_result.block_number;
+            response->transaction_index = tx_result.transaction_index;
+
+            // The block hash is only known once the block has been sealed
+            const auto block =
+              make_block_builder(tx).get_sealed(tx_result.block_number);
+            if (block.has_value())
+            {
+              response->block_hash = block->block_hash;
+            }
+          }
+
+          metrics::Timer t(metrics::Phase::SerialiseResponse);
+          return jsonrpc::success(response);
+        };
+
+      auto block_number = [this](Store::Tx& tx, const nlohmann::json& params) {
+        const auto latest = make_block_builder(tx).latest_number();
+        metrics::Timer t(metrics::Phase::SerialiseResponse);
+        return jsonrpc::success(hex::to_hex_string(latest));
+      };
+
+      auto get_block_by_number =
+        [this](Store::Tx& tx, const nlohmann::json& params) {
+          const auto gbp = parse<rpcparams::GetBlockByNumber>(params);
+          if (gbp.full_transactions)
+          {
+            return jsonrpc::error(
+              jsonrpc::StandardErrorCodes::INVALID_PARAMS,
+              "Full transaction objects are not stored, only their hashes");
           }
 
+          const rpcresults::BlockResponse response =
+            make_block_builder(tx).get_by_id(gbp.block_id);
+          metrics::Timer t(metrics::Phase::SerialiseResponse);
           return jsonrpc::success(response);
         };
 
-      install(ethrpc::Call::name, call, Read);
-      install(ethrpc::GetBalance::name, get_balance, Read);
-      install(ethrpc::GetCode::name, get_code, Read);
-      install(ethrpc::GetTransactionCount::name, get_transaction_count, Read);
-      install(
+      // Latencies can reveal what other users' transactions do, so they are
+      // only available to operators
+      auto get_metrics = [this](RequestArgs& args) {
+        if (!get_operator(args.tx, args.caller_id).has_value())
+        {
+          return operators_only(apprpc::GetMetrics::name);
+        }
+        return jsonrpc::success(method_metrics.to_json());
+      };
+
+      install_timed(ethrpc::BlockNumber::name, block_number, Read);
+      install_timed(ethrpc::Call::name, call, Read);
+      install_timed(ethrpc::GetBalance::name, get_balance, Read);
+      install_timed(
+        ethrpc::GetBlockByNumber::name, get_block_by_number, Read);
+      install_timed(ethrpc::GetCode::name, get_code, Read);
+      install_timed(
+        ethrpc::GetTransactionCount::name, get_transaction_count, Read);
+      install_timed(
         ethrpc::GetTransactionReceipt::name, get_transaction_receipt, Read);
-      install(ethrpc::SendRawTransaction::name, send_raw_transaction, Write);
-      install(ethrpc::SendTransaction::name, send_transaction, Write);
+      install_timed(
+        ethrpc::SendRawTransaction::name, send_raw_transaction, Write);
+      install_timed(ethrpc::SendTransaction::name, send_transaction, Write);
+
+      install(apprpc::GetMetrics::name, get_metrics, Read);
+
+      auto get_tracing = [this](RequestArgs& args) {
+        if (!get_operator(args.tx, args.caller_id).has_value())
+        {
+          return operators_only(apprpc::GetTracing::name);
+        }
+
+        sync_tracing(args.tx);
+        return jsonrpc::success(trace_sampler.to_json());
+      };
+
+      // Settings are stored rather than applied directly, so that every node
+      // traces the same executions
+      auto set_tracing = [this](RequestArgs& args) {
+        const auto operator_address = get_operator(args.tx, args.caller_id);
+        if (!operator_address.has_value())
+        {
+          return operators_only(apprpc::SetTracing::name);
+        }
+
+        const auto sp = parse<rpcparams::SetTracing>(args.params);
+        for (const auto& address : sp.addresses)
+        {
+          if (address != *operator_address)
+          {
+            return jsonrpc::error(
+              jsonrpc::StandardErrorCodes::INVALID_PARAMS,
+              fmt::format(
+                "Operators may only force tracing of their own address {}",
+                keccak::to_checksum_address(*operator_address)));
+          }
+        }
+
+        auto settings_view = args.tx.get_view(tracing_settings);
+        const auto current = settings_view->get(tables::tracing_key);
+
+        TracingSettings settings;
+        settings.generation = current.has_value() ? current->generation + 1 : 1;
+        settings.sample_every = sp.sample_every;
+        settings.tail_length = sp.tail_length;
+        settings.addresses = sp.addresses;
+        settings_view->put(tables::tracing_key, settings);
+
+        return jsonrpc::success(true);
+      };
+
+      install(apprpc::GetTracing::name, get_tracing, Read);
+      install(apprpc::SetTracing::name, set_tracing, Write);
+
+#ifdef RECORD_OPCODE_STATS
+      // Per-contract statistics reveal which contracts are being called, so
+      // they are only available to operators
+      auto get_opcode_stats = [this](RequestArgs& args) {
+        if (!get_operator(args.tx, args.caller_id).has_value())
+        {
+          return operators_only(apprpc::GetOpcodeStats::name);
+        }
+        return jsonrpc::success(code_stats.to_json());
+      };
+
+      auto reset_opcode_stats = [this](RequestArgs& args) {
+        if (!get_operator(args.tx, args.caller_id).has_value())
+        {
+          return operators_only(apprpc::ResetOpcodeStats::name);
+        }
+        code_stats.reset();
+        return jsonrpc::success(true);
+      };
+
+      install(apprpc::GetOpcodeStats::name, get_opcode_stats, Read);
+      install(apprpc::ResetOpcodeStats::name, reset_opcode_stats, Write);
+#endif
     }
 
   public:
     // SNIPPET_START: initialization
-    EVMForCCFFrontend(NetworkTables& nwt, AbstractNotifier& notifier) :
+    EVMForCCFFrontend(
+      NetworkTables& nwt,
+      AbstractNotifier& notifier,
+      size_t transactions_per_block = TRANSACTIONS_PER_BLOCK,
+      uint64_t history_retention = HISTORY_RETENTION_BLOCKS,
+      uint64_t receipt_retention = RECEIPT_RETENTION_BLOCKS) :
       UserRpcFrontend(*nwt.tables),
       accounts{tables.create<tables::Accounts::Balances>("eth.account.balance"),
                tables.create<tables::Accounts::Codes>("eth.account.code"),
                tables.create<tables::Accounts::Nonces>("eth.account.nonce")},
       storage(tables.create<tables::Storage>("eth.storage")),
-      tx_results(tables.create<tables::Results>("eth.txresults"))
+      tx_results(tables.create<tables::Results>("eth.txresults")),
+      archived_results(
+        tables.create<tables::ArchivedResults>("eth.txresults.archive")),
+      blocks(tables.create<tables::Blocks>("eth.blocks")),
+      pending_block(tables.create<tables::PendingBlock>("eth.blocks.pending")),
+      history{
+        tables::History::Balances::create(tables, "eth.history.balance"),
+        tables::History::Codes::create(tables, "eth.history.code"),
+        tables::History::Nonces::create(tables, "eth.history.nonce"),
+        tables::History::Storage::create(tables, "eth.history.storage"),
+        tables.create<tables::History::Created>("eth.history.created"),
+        tables.create<tables::History::Deltas>("eth.history.deltas")},
+      operators(tables.create<tables::Operators>("eth.operators")),
+      tracing_settings(tables.create<tables::Tracing>("eth.tracing")),
+      transaction_queue{
+        tables.create<tables::TransactionQueue::Queued>("eth.txqueue"),
+        tables.create<tables::TransactionQueue::Counts>("eth.txqueue.counts")},
+      transactions_per_block(std::max<size_t>(transactions_per_block, 1)),
+      history_retention(history_retention),
+      receipt_retention(receipt_retention),
+      trace_sampler(TRACE_SAMPLE_EVERY, TRACE_TAIL_LENGTH)
     // SNIPPET_END: initialization
     {
       install_standard_rpcs();
     }
 
   private:
-    static std::pair<ExecResult, AccountState> run_in_evm(
-      const rpcparams::MessageCall& call_data,
+    // force_trace traces this execution, whatever the tracing settings
+    std::pair<ExecResult, AccountState> run_in_evm(
+      const MessageCall& call_data,
       EthereumState& es,
-      LogHandler& log_handler)
+      LogHandler& log_handler,
+      bool force_trace)
     {
+      metrics::Timer t(metrics::Phase::Execute);
+
       Address from = call_data.from;
       Address to;
 
@@ -212,17 +651,29 @@ namespace evm4ccf
       {
         // If there's no to field, create a new account to deploy this to
         const auto from_state = es.get(from);
-        to = eevm::generate_address(
+        to = keccak::generate_address(
           from_state.acc.get_address(), from_state.acc.get_nonce());
-        es.create(to, call_data.gas, to_bytes(call_data.data));
+        es.create(to, call_data.gas, call_data.data);
       }
 
       Transaction eth_tx(from, log_handler);
 
+      // Read the state named by the access list before interpretation starts
+      es.prefetch(call_data.access_list);
+
       auto account_state = es.get(to);
 
-#ifdef RECORD_TRACE
+      const auto sampled = trace_sampler.should_trace(from, to, force_trace);
+#ifdef RECORD_OPCODE_STATS
+      // Opcodes are counted from the trace, so every execution is traced
+      const auto traced = true;
+#else
+      const auto traced = sampled;
+#endif
       eevm::Trace tr;
+
+#ifdef RECORD_OPCODE_STATS
+      const auto start_time = opcode_stats::read_time();
 #endif
 
       Processor proc(es);
@@ -230,44 +681,251 @@ namespace evm4ccf
         eth_tx,
         from,
         account_state,
-        to_bytes(call_data.data),
-        call_data.value
-#ifdef RECORD_TRACE
-        ,
-        &tr
+        call_data.data,
+        call_data.value,
+        traced ? &tr : nullptr);
+
+#ifdef RECORD_OPCODE_STATS
+      const auto elapsed = opcode_stats::read_time() - start_time;
+      code_stats.record(
+        opcode_stats::count_opcodes(
+          tr,
+          to,
+          [&es](const Address& address) {
+            return es.get(address).acc.get_nonce();
+          }),
+        elapsed);
 #endif
-      );
 
-#ifdef RECORD_TRACE
-      if (result.er == ExitReason::threw)
+      if (sampled && result.er == ExitReason::threw)
       {
-        LOG_INFO_FMT("--- Trace of failing evm execution ---\n{}", tr);
-      }
+        trace_sampler.record_failure(tr);
+#ifdef RECORD_TRACE
+        // The host's log is outside the enclave, so only debug builds write
+        // execution state to it
+        LOG_INFO_FMT(
+          "--- Trace of failing evm execution ---\n{}",
+          trace_sampler.tail(tr));
 #endif
+      }
 
       return std::make_pair(result, account_state);
     }
 
-    static pair<ExecResult, AccountState> run_in_evm(
-      const rpcparams::MessageCall& call_data, EthereumState& es)
+    pair<ExecResult, AccountState> run_in_evm(
+      const MessageCall& call_data, EthereumState& es, bool force_trace)
     {
       NullLogHandler ignore;
-      return run_in_evm(call_data, es, ignore);
+      return run_in_evm(call_data, es, ignore, force_trace);
+    }
+
+    // Signed transactions carry a nonce, which must not already have been
+    // used. One ahead of the sender's next nonce is queued rather than
+    // rejected, so a sender may pipeline several of them in any order
+    pair<bool, nlohmann::json> submit_transaction(
+      CallerId caller_id,
+      const MessageCall& call_data,
+      Store::Tx& tx,
+      size_t nonce,
+      const std::vector<uint8_t>& raw,
+      bool force_trace)
+    {
+      // Checked against the nonces table directly, before any state is
+      // built, so that a rejected transaction neither creates the sender's
+      // account nor records history
+      const auto expected =
+        tx.get_view(accounts.nonces)->get(call_data.from).value_or(0);
+      if (nonce < expected)
+      {
+        return jsonrpc::error(
+          jsonrpc::StandardErrorCodes::INVALID_PARAMS,
+          fmt::format(
+            "Transaction nonce {} has already been used. The sender's next "
+            "nonce is {}",
+            nonce,
+            expected));
+      }
+
+      if (nonce > expected)
+      {
+        return queue_transaction(
+          call_data, tx, nonce, expected, raw, force_trace);
+      }
+
+      return execute_transaction(caller_id, call_data, tx, force_trace);
+    }
+
+    // Stores a transaction until its sender's nonce reaches it. It is
+    // acknowledged with the hash it will execute under, before it executes
+    pair<bool, nlohmann::json> queue_transaction(
+      const MessageCall& call_data,
+      Store::Tx& tx,
+      size_t nonce,
+      size_t expected,
+      const std::vector<uint8_t>& raw,
+      bool force_trace)
+    {
+      if (nonce - expected >= QUEUED_TRANSACTIONS_PER_SENDER)
+      {
+        return jsonrpc::error(
+          jsonrpc::StandardErrorCodes::INVALID_PARAMS,
+          fmt::format(
+            "Transaction nonce {} is too far ahead of the sender's next nonce "
+            "{}. At most {} transactions per sender are queued",
+            nonce,
+            expected,
+            QUEUED_TRANSACTIONS_PER_SENDER));
+      }
+
+      auto queue = transaction_queue.get_views(tx);
+      const tables::TransactionQueue::Key key{call_data.from, nonce};
+      if (queue.queued->get(key).has_value())
+      {
+        return jsonrpc::error(
+          jsonrpc::StandardErrorCodes::INVALID_PARAMS,
+          fmt::format(
+            "A transaction with nonce {} is already queued for this sender",
+            nonce));
+      }
+
+      queue.queued->put(key, {raw, force_trace});
+      queue.counts->put(
+        call_data.from, queue.counts->get(call_data.from).value_or(0) + 1);
+
+      metrics::Timer t(metrics::Phase::SerialiseResponse);
+      return jsonrpc::success(
+        hex::to_hex_string_fixed(hash_transaction(nonce, call_data)));
+    }
+
+    struct UnblockedTransaction
+    {
+      MessageCall call_data;
+      bool trace;
+    };
+
+    // The queued transactions from a sender with consecutive nonces starting
+    // at next, in the order they will execute
+    std::vector<UnblockedTransaction> get_unblocked(
+      const tables::TransactionQueue::Views& queue,
+      const Address& from,
+      size_t next)
+    {
+      std::vector<UnblockedTransaction> unblocked;
+      for (auto nonce = next;; ++nonce)
+      {
+        const auto queued = queue.queued->get({from, nonce});
+        if (!queued.has_value())
+        {
+          break;
+        }
+
+        // The sender was recovered when the transaction was queued
+        UnblockedTransaction& u = unblocked.emplace_back();
+        SignedTransactionView({queued->raw.data(), queued->raw.size()})
+          .to_message_call(u.call_data, from);
+        u.trace = queued->trace;
+      }
+      return unblocked;
     }
 
-    // TODO: This and similar should take EthereumTransaction, not
-    // MessageCall. EthereumTransaction should be fully parsed, then
-    // MessageCall can be removed
+    void dequeue(
+      const tables::TransactionQueue::Views& queue,
+      const Address& from,
+      size_t first,
+      size_t n)
+    {
+      if (n == 0)
+      {
+        return;
+      }
+
+      for (size_t i = 0; i < n; ++i)
+      {
+        queue.queued->remove({from, first + i});
+      }
+
+      const auto remaining = queue.counts->get(from).value_or(n) - n;
+      if (remaining == 0)
+      {
+        queue.counts->remove(from);
+      }
+      else
+      {
+        queue.counts->put(from, remaining);
+      }
+    }
+
+    // Executes a transaction at its sender's next nonce, then drains any
+    // queued transactions from that sender which it unblocks, in nonce order
     pair<bool, nlohmann::json> execute_transaction(
       CallerId caller_id,
-      const rpcparams::MessageCall& call_data,
-      Store::Tx& tx)
+      const MessageCall& call_data,
+      Store::Tx& tx,
+      bool force_trace)
     {
-      auto es = make_state(tx);
+      const auto next =
+        tx.get_view(accounts.nonces)->get(call_data.from).value_or(0) + 1;
+      const auto queue = transaction_queue.get_views(tx);
+      const auto unblocked = get_unblocked(queue, call_data.from, next);
+
+      // A failed execution's writes cannot be undone without aborting the
+      // whole KV transaction. So the batch is first run in a scratch
+      // transaction, never committed, to find the first queued transaction
+      // which fails. Nothing has been written to tx yet, so both start from
+      // the same state
+      size_t runnable = unblocked.size();
+      if (!unblocked.empty())
+      {
+        Store::Tx scratch;
+        if (execute_and_record(scratch, call_data, false).first)
+        {
+          for (size_t i = 0; i < unblocked.size(); ++i)
+          {
+            if (!execute_and_record(scratch, unblocked[i].call_data, false)
+                   .first)
+            {
+              runnable = i;
+              break;
+            }
+          }
+        }
+      }
+
+      auto result = execute_and_record(tx, call_data, force_trace);
+      if (!result.first)
+      {
+        return result;
+      }
+
+      // The failing transaction is dropped from the queue with those before
+      // it. Any after it wait for its nonce to be sent again
+      dequeue(
+        queue,
+        call_data.from,
+        next,
+        std::min(runnable + 1, unblocked.size()));
+      for (size_t i = 0; i < runnable; ++i)
+      {
+        const auto drained = execute_and_record(
+          tx, unblocked[i].call_data, unblocked[i].trace);
+        if (!drained.first)
+        {
+          return drained;
+        }
+      }
+
+      return result;
+    }
 
-      VectorLogHandler vlh;
+    pair<bool, nlohmann::json> execute_and_record(
+      Store::Tx& tx, const MessageCall& call_data, bool force_trace)
+    {
+      sync_tracing(tx);
+      auto es = make_recording_state(tx);
+
+      ReceiptLogHandler log_handler;
       const auto [exec_result, tx_hash, to_address] =
-        execute_transaction(call_data, es, vlh);
+        execute_transaction(call_data, es, log_handler, force_trace);
 
       if (exec_result.er == ExitReason::threw)
       {
@@ -275,27 +933,60 @@ namespace evm4ccf
           jsonrpc::StandardErrorCodes::INTERNAL_ERROR, exec_result.exmsg);
       }
 
-      auto results_view = tx.get_view(tx_results);
-      TxResult tx_result;
-      if (!call_data.to.has_value())
       {
-        tx_result.contract_address = to_address;
+        metrics::Timer t(metrics::Phase::WriteReceipt);
+
+        auto results_view = tx.get_view(tx_results);
+        TxResult tx_result;
+        if (!call_data.to.has_value())
+        {
+          tx_result.contract_address = to_address;
+        }
+
+        tx_result.logs = std::move(log_handler.logs);
+
+        auto block_builder = make_block_builder(tx);
+        const auto [block_number, transaction_index] =
+          block_builder.add_transaction(tx_hash, transactions_per_block);
+        tx_result.block_number = block_number;
+        tx_result.transaction_index = transaction_index;
+
+        results_view->put(tx_hash, tx_result);
+        es.write_history_delta(transaction_index);
+
+        if (transaction_index + 1 == transactions_per_block)
+        {
+          evict_results(
+            block_builder,
+            results_view,
+            tx.get_view(archived_results),
+            block_number,
+            receipt_retention);
+          prune_history(tx, block_builder, block_number);
+        }
       }
 
-      tx_result.logs = vlh.logs;
+      metrics::Timer t(metrics::Phase::SerialiseResponse);
+      return jsonrpc::success(hex::to_hex_string_fixed(tx_hash));
+    }
 
-      results_view->put(tx_hash, tx_result);
+    static TxHash hash_transaction(size_t nonce, const MessageCall& call_data)
+    {
+      metrics::Timer t(metrics::Phase::HashTransaction);
+      const auto rlp_encoded = encode_unsigned_transaction(nonce, call_data);
 
-      return jsonrpc::success(eevm::to_hex_string_fixed(tx_hash));
+      const auto h = keccak::keccak_256(rlp_encoded);
+      return eevm::from_big_endian(h.data());
     }
 
-    static std::tuple<ExecResult, TxHash, Address> execute_transaction(
-      const rpcparams::MessageCall& call_data,
+    std::tuple<ExecResult, TxHash, Address> execute_transaction(
+      const MessageCall& call_data,
       EthereumState& es,
-      LogHandler& log_handler)
+      LogHandler& log_handler,
+      bool force_trace)
     {
       auto [exec_result, account_state] =
-        run_in_evm(call_data, es, log_handler);
+        run_in_evm(call_data, es, log_handler, force_trace);
 
       if (exec_result.er == ExitReason::threw)
       {
@@ -312,15 +1003,7 @@ namespace evm4ccf
       auto tx_nonce = from_state.acc.get_nonce();
       from_state.acc.increment_nonce();
 
-      EthereumTransaction eth_tx(tx_nonce, call_data);
-      const auto rlp_encoded = eth_tx.encode();
-
-      uint8_t h[32];
-      const auto raw =
-        reinterpret_cast<unsigned char const*>(rlp_encoded.data());
-      eevm::keccak_256(raw, rlp_encoded.size(), h);
-
-      const auto tx_hash = eevm::from_big_endian(h);
+      const auto tx_hash = hash_transaction(tx_nonce, call_data);
 
       return std::make_tuple(
         exec_result, tx_hash, account_state.acc.get_address());
@@ -0,0 +1,222 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#pragma once
+
+// STL/3rd-party
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <utility>
+
+// Latency breakdown of RPC handlers. Each handler runs inside a MethodScope,
+// which times the whole handler and is current on this thread until it
+// returns. Timers placed around the phases of a handler add to the current
+// scope, so shared helpers such as execute_transaction are attributed to
+// whichever method called them. When the scope ends, each phase's total for
+// the request is added to the method's histograms. Timers do nothing outside
+// a MethodScope.
+namespace evm4ccf::metrics
+{
+  using Clock = std::chrono::steady_clock;
+
+  enum class Phase : size_t
+  {
+    ParseParams,
+    RecoverSender,
+    MakeState,
+    Execute,
+    HashTransaction,
+    WriteReceipt,
+    SerialiseResponse,
+    Handler,
+    Count
+  };
+
+  constexpr size_t n_phases = static_cast<size_t>(Phase::Count);
+
+  inline const char* phase_name(Phase phase)
+  {
+    constexpr std::array<const char*, n_phases> names = {"parse_params",
+                                                         "recover_sender",
+                                                         "make_state",
+                                                         "execute",
+                                                         "hash_transaction",
+                                                         "write_receipt",
+                                                         "serialise_response",
+                                                         "handler"};
+    return names[static_cast<size_t>(phase)];
+  }
+
+  // Counts of durations in power-of-two buckets. Bucket i holds durations
+  // below 2^i ns, and at least 2^(i-1) ns. Updates are relaxed atomics, so
+  // handlers on different threads can record concurrently
+  class Histogram
+  {
+    static constexpr size_t n_buckets = 48;
+
+    std::array<std::atomic<uint64_t>, n_buckets> buckets = {};
+    std::atomic<uint64_t> count = 0;
+    std::atomic<uint64_t> total_ns = 0;
+    std::atomic<uint64_t> max_ns = 0;
+
+  public:
+    void record(uint64_t ns)
+    {
+      const size_t bucket =
+        ns == 0 ? 0 : 64 - static_cast<size_t>(__builtin_clzll(ns));
+      buckets[std::min(bucket, n_buckets - 1)].fetch_add(
+        1, std::memory_order_relaxed);
+      count.fetch_add(1, std::memory_order_relaxed);
+      total_ns.fetch_add(ns, std::memory_order_relaxed);
+
+      auto max = max_ns.load(std::memory_order_relaxed);
+      while (ns > max &&
+             !max_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+      {
+      }
+    }
+
+    uint64_t get_count() const
+    {
+      return count.load(std::memory_order_relaxed);
+    }
+
+    nlohmann::json to_json() const
+    {
+      const auto n = get_count();
+
+      auto histogram = nlohmann::json::array();
+      for (size_t i = 0; i < n_buckets; ++i)
+      {
+        const auto in_bucket = buckets[i].load(std::memory_order_relaxed);
+        if (in_bucket != 0)
+        {
+          histogram.push_back(
+            {{"lt_ns", uint64_t(1) << i}, {"count", in_bucket}});
+        }
+      }
+
+      return {
+        {"count", n},
+        {"mean_ns",
+         n == 0 ? 0 : total_ns.load(std::memory_order_relaxed) / n},
+        {"max_ns", max_ns.load(std::memory_order_relaxed)},
+        {"histogram", histogram}};
+    }
+  };
+
+  struct MethodMetrics
+  {
+    std::array<Histogram, n_phases> phases;
+
+    nlohmann::json to_json() const
+    {
+      auto j = nlohmann::json::object();
+      for (size_t i = 0; i < n_phases; ++i)
+      {
+        // Phases which a method never reaches are omitted
+        if (phases[i].get_count() != 0)
+        {
+          j[phase_name(static_cast<Phase>(i))] = phases[i].to_json();
+        }
+      }
+      return j;
+    }
+  };
+
+  // Methods are added when handlers are installed, so the registry itself is
+  // only read while requests are being processed
+  class Registry
+  {
+    std::map<std::string, std::unique_ptr<MethodMetrics>> methods;
+
+  public:
+    MethodMetrics& add(const std::string& method)
+    {
+      auto& m = methods[method];
+      if (m == nullptr)
+      {
+        m = std::make_unique<MethodMetrics>();
+      }
+      return *m;
+    }
+
+    nlohmann::json to_json() const
+    {
+      auto j = nlohmann::json::object();
+      for (const auto& [name, m] : methods)
+      {
+        j[name] = m->to_json();
+      }
+      return j;
+    }
+  };
+
+  class MethodScope;
+  inline thread_local MethodScope* current = nullptr;
+
+  class MethodScope
+  {
+    MethodMetrics& method;
+    MethodScope* const previous;
+    const Clock::time_point start;
+
+    std::array<uint64_t, n_phases> elapsed_ns = {};
+    std::array<bool, n_phases> reached = {};
+
+  public:
+    explicit MethodScope(MethodMetrics& m) :
+      method(m),
+      previous(std::exchange(current, this)),
+      start(Clock::now())
+    {}
+
+    ~MethodScope()
+    {
+      add(Phase::Handler, Clock::now() - start);
+      for (size_t i = 0; i < n_phases; ++i)
+      {
+        if (reached[i])
+        {
+          method.phases[i].record(elapsed_ns[i]);
+        }
+      }
+      current = previous;
+    }
+
+    void add(Phase phase, Clock::duration elapsed)
+    {
+      const auto i = static_cast<size_t>(phase);
+      elapsed_ns[i] +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+      reached[i] = true;
+    }
+  };
+
+  class Timer
+  {
+    MethodScope* const scope;
+    const Phase phase;
+    const Clock::time_point start;
+
+  public:
+    explicit Timer(Phase p) :
+      scope(current),
+      phase(p),
+      start(scope == nullptr ? Clock::time_point() : Clock::now())
+    {}
+
+    ~Timer()
+    {
+      if (scope != nullptr)
+      {
+        scope->add(phase, Clock::now() - start);
+      }
+    }
+  };
+} // namespace evm4ccf::metrics
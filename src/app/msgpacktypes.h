@@ -73,20 +73,44 @@ namespace msgpack
         }
       };
 
-      // msgpack conversion for evm4ccf::TxResult
+      // msgpack conversion for evm4ccf::TxResult. Results are written as a
+      // version number followed by their compact encoding. Results written
+      // before that are arrays whose first element is the contract address
       template <>
       struct convert<evm4ccf::TxResult>
       {
         msgpack::object const& operator()(
           msgpack::object const& o, evm4ccf::TxResult& v) const
         {
-          auto addr = o.via.array.ptr[0].as<eevm::Address>();
+          const auto& first = o.via.array.ptr[0];
+          if (first.type == msgpack::type::POSITIVE_INTEGER)
+          {
+            const auto version = first.as<uint64_t>();
+            if (version != evm4ccf::receipts::compact_version)
+            {
+              throw std::logic_error(
+                "Unknown receipt version " + std::to_string(version));
+            }
+            v = evm4ccf::receipts::decode(
+              o.via.array.ptr[1].as<std::vector<uint8_t>>());
+            return o;
+          }
+
+          v = {};
+          auto addr = first.as<eevm::Address>();
           if (addr != 0)
           {
             v.contract_address = addr;
           }
           v.logs = o.via.array.ptr[1].as<std::vector<eevm::LogEntry>>();
 
+          // Results written before blocks were produced have no position
+          if (o.via.array.size > 2)
+          {
+            v.block_number = o.via.array.ptr[2].as<uint64_t>();
+            v.transaction_index = o.via.array.ptr[3].as<uint64_t>();
+          }
+
           return o;
         }
       };
@@ -99,8 +123,8 @@ namespace msgpack
           msgpack::packer<Stream>& o, evm4ccf::TxResult const& v) const
         {
           o.pack_array(2);
-          o.pack(v.contract_address.value_or(0x0));
-          o.pack(v.logs);
+          o.pack(evm4ccf::receipts::compact_version);
+          o.pack(evm4ccf::receipts::encode(v));
           return o;
         }
       };
@@ -120,6 +144,14 @@ namespace msgpack
           v.miner = o.via.array.ptr[5].as<decltype(v.miner)>();
           v.block_hash = o.via.array.ptr[6].as<decltype(v.block_hash)>();
 
+          // Headers serialised before blocks were produced have no links
+          if (o.via.array.size > 7)
+          {
+            v.parent_hash = o.via.array.ptr[7].as<decltype(v.parent_hash)>();
+            v.transactions =
+              o.via.array.ptr[8].as<decltype(v.transactions)>();
+          }
+
           return o;
         }
       };
@@ -131,7 +163,7 @@ namespace msgpack
         packer<Stream>& operator()(
           msgpack::packer<Stream>& o, evm4ccf::BlockHeader const& v) const
         {
-          o.pack_array(7);
+          o.pack_array(9);
           o.pack(v.number);
           o.pack(v.difficulty);
           o.pack(v.gas_limit);
@@ -139,6 +171,97 @@ namespace msgpack
           o.pack(v.timestamp);
           o.pack(v.miner);
           o.pack(v.block_hash);
+          o.pack(v.parent_hash);
+          o.pack(v.transactions);
+          return o;
+        }
+      };
+
+      // msgpack conversion for evm4ccf::HistoryDelta
+      template <>
+      struct convert<evm4ccf::HistoryDelta>
+      {
+        msgpack::object const& operator()(
+          msgpack::object const& o, evm4ccf::HistoryDelta& v) const
+        {
+          v.balances = o.via.array.ptr[0].as<decltype(v.balances)>();
+          v.codes = o.via.array.ptr[1].as<decltype(v.codes)>();
+          v.nonces = o.via.array.ptr[2].as<decltype(v.nonces)>();
+          v.storage = o.via.array.ptr[3].as<decltype(v.storage)>();
+          return o;
+        }
+      };
+
+      template <>
+      struct pack<evm4ccf::HistoryDelta>
+      {
+        template <typename Stream>
+        packer<Stream>& operator()(
+          msgpack::packer<Stream>& o, evm4ccf::HistoryDelta const& v) const
+        {
+          o.pack_array(4);
+          o.pack(v.balances);
+          o.pack(v.codes);
+          o.pack(v.nonces);
+          o.pack(v.storage);
+          return o;
+        }
+      };
+
+      // msgpack conversion for evm4ccf::TracingSettings
+      template <>
+      struct convert<evm4ccf::TracingSettings>
+      {
+        msgpack::object const& operator()(
+          msgpack::object const& o, evm4ccf::TracingSettings& v) const
+        {
+          v.generation = o.via.array.ptr[0].as<uint64_t>();
+          v.sample_every = o.via.array.ptr[1].as<size_t>();
+          v.tail_length = o.via.array.ptr[2].as<size_t>();
+          v.addresses = o.via.array.ptr[3].as<decltype(v.addresses)>();
+          return o;
+        }
+      };
+
+      template <>
+      struct pack<evm4ccf::TracingSettings>
+      {
+        template <typename Stream>
+        packer<Stream>& operator()(
+          msgpack::packer<Stream>& o, evm4ccf::TracingSettings const& v) const
+        {
+          o.pack_array(4);
+          o.pack(v.generation);
+          o.pack(v.sample_every);
+          o.pack(v.tail_length);
+          o.pack(v.addresses);
+          return o;
+        }
+      };
+
+      // msgpack conversion for evm4ccf::QueuedTransaction
+      template <>
+      struct convert<evm4ccf::QueuedTransaction>
+      {
+        msgpack::object const& operator()(
+          msgpack::object const& o, evm4ccf::QueuedTransaction& v) const
+        {
+          v.raw = o.via.array.ptr[0].as<std::vector<uint8_t>>();
+          v.trace = o.via.array.ptr[1].as<bool>();
+          return o;
+        }
+      };
+
+      template <>
+      struct pack<evm4ccf::QueuedTransaction>
+      {
+        template <typename Stream>
+        packer<Stream>& operator()(
+          msgpack::packer<Stream>& o, evm4ccf::QueuedTransaction const& v) const
+        {
+          o.pack_array(2);
+          o.pack(v.raw);
+          o.pack(v.trace);
           return o;
         }
       };
@@ -9,25 +9,73 @@ namespace evm4ccf
     const auto it = j.find("address");
     if (it != j.end() && !it->is_null())
     {
-      txr.contract_address = eevm::to_uint256(*it);
+      txr.contract_address = hex::to_uint256(*it);
     }
     else
     {
       txr.contract_address = std::nullopt;
     }
-    txr.logs = j["logs"].get<decltype(TxResult::logs)>();
+    txr.logs = j["logs"].get<std::vector<eevm::LogEntry>>();
+    txr.block_number = j.value("blockNumber", uint64_t(0));
+    txr.transaction_index = j.value("transactionIndex", uint64_t(0));
   }
 
   inline void to_json(nlohmann::json& j, const TxResult& txr)
   {
     if (txr.contract_address.has_value())
     {
-      j["address"] = eevm::to_hex_string(*txr.contract_address);
+      j["address"] = hex::to_hex_string(*txr.contract_address);
     }
     else
     {
       j["address"] = nullptr;
     }
-    j["logs"] = txr.logs;
+    j["logs"] = txr.logs.to_log_entries();
+    j["blockNumber"] = txr.block_number;
+    j["transactionIndex"] = txr.transaction_index;
+  }
+
+  inline void from_json(const nlohmann::json& j, HistoryDelta& d)
+  {
+    d.balances = j["balances"].get<decltype(HistoryDelta::balances)>();
+    d.codes = j["codes"].get<decltype(HistoryDelta::codes)>();
+    d.nonces = j["nonces"].get<decltype(HistoryDelta::nonces)>();
+    d.storage = j["storage"].get<decltype(HistoryDelta::storage)>();
+  }
+
+  inline void to_json(nlohmann::json& j, const HistoryDelta& d)
+  {
+    j["balances"] = d.balances;
+    j["codes"] = d.codes;
+    j["nonces"] = d.nonces;
+    j["storage"] = d.storage;
+  }
+
+  inline void from_json(const nlohmann::json& j, TracingSettings& t)
+  {
+    t.generation = j["generation"];
+    t.sample_every = j["sampleEvery"];
+    t.tail_length = j["tailLength"];
+    t.addresses = j["addresses"].get<decltype(TracingSettings::addresses)>();
+  }
+
+  inline void to_json(nlohmann::json& j, const TracingSettings& t)
+  {
+    j["generation"] = t.generation;
+    j["sampleEvery"] = t.sample_every;
+    j["tailLength"] = t.tail_length;
+    j["addresses"] = t.addresses;
+  }
+
+  inline void from_json(const nlohmann::json& j, QueuedTransaction& q)
+  {
+    q.raw = hex::to_bytes(j["raw"].get<std::string>());
+    q.trace = j["trace"];
+  }
+
+  inline void to_json(nlohmann::json& j, const QueuedTransaction& q)
+  {
+    j["raw"] = hex::to_hex_string(q.raw);
+    j["trace"] = q.trace;
   }
 } // namespace evm4ccf
@@ -0,0 +1,232 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#pragma once
+
+// EVM-for-CCF
+#include "cpu_features.h"
+#include "hex_encoding.h"
+#include "keccak256.h"
+
+// eEVM
+#include <eEVM/opcode.h>
+#include <eEVM/stack.h>
+#include <eEVM/trace.h>
+#include <eEVM/util.h>
+
+// STL/3rd-party
+#include <array>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <vector>
+
+// RDTSC may not be executed inside an SGX1 enclave, so enclave builds time
+// executions with the steady clock instead
+#if defined(EVM4CCF_X86) && !defined(INSIDE_ENCLAVE)
+#  define EVM4CCF_READ_TSC
+#  include <x86intrin.h>
+#endif
+
+// Opcode execution counts and execution time, aggregated by contract. Only
+// built with RECORD_OPCODE_STATS, which turns on full tracing: every
+// execution is run with an eevm::Trace, whatever the sampling settings, and
+// its events are attributed once it returns.
+//
+// Each opcode is attributed to the contract whose code executed it. The trace
+// only records each step's call depth, so the contract running each nested
+// frame is found from the CALL, CALLCODE, DELEGATECALL or CREATE step which
+// entered it. The Processor has no per-instruction hook, so time is measured
+// per execution, and shared between its contracts by the number of opcodes
+// each executed.
+namespace evm4ccf::opcode_stats
+{
+  using OpcodeCounts = std::array<uint64_t, 256>;
+
+  // Opcodes executed during one execution, by the address of the contract
+  // whose code executed them
+  using ContractOpcodes = std::map<eevm::Address, OpcodeCounts>;
+
+#ifdef EVM4CCF_READ_TSC
+  static constexpr auto time_unit = "cycles";
+#else
+  static constexpr auto time_unit = "ns";
+#endif
+
+  inline uint64_t read_time()
+  {
+#ifdef EVM4CCF_READ_TSC
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+  }
+
+  // A call frame runs the code of one contract against the balance, nonce
+  // and storage of an account, which differ after CALLCODE and DELEGATECALL
+  struct Frame
+  {
+    eevm::Address account;
+    eevm::Address code;
+  };
+
+  // The frame that a step enters if it is a call or a create, which is only
+  // run if the next step is deeper. get_nonce returns an account's nonce,
+  // from which eEVM derives the addresses of the contracts it creates
+  template <typename GetNonce>
+  std::optional<Frame> entered_frame(
+    const eevm::TraceEvent& event, const Frame& caller, GetNonce& get_nonce)
+  {
+    switch (event.op)
+    {
+      case eevm::Opcode::CALL:
+      case eevm::Opcode::CALLCODE:
+      case eevm::Opcode::DELEGATECALL:
+      {
+        // The gas limit is on top of the stack, and the callee below it
+        eevm::Stack stack(*event.s);
+        stack.pop();
+        const eevm::Address callee =
+          stack.pop() & ((uint256_t(1) << 160) - 1);
+
+        if (event.op == eevm::Opcode::CALL)
+        {
+          return Frame{callee, callee};
+        }
+        return Frame{caller.account, callee};
+      }
+
+      case eevm::Opcode::CREATE:
+      {
+        const auto created = keccak::generate_address(
+          caller.account, get_nonce(caller.account));
+        return Frame{created, created};
+      }
+
+      default:
+        return std::nullopt;
+    }
+  }
+
+  // Attributes the opcodes of a trace to the contracts which executed them,
+  // keeping a stack of the frames entered below the called contract
+  template <typename GetNonce>
+  ContractOpcodes count_opcodes(
+    const eevm::Trace& trace, const eevm::Address& callee, GetNonce&& get_nonce)
+  {
+    ContractOpcodes counts;
+    if (trace.events.empty())
+    {
+      return counts;
+    }
+
+    const auto base_depth = trace.events.front().call_depth;
+    std::vector<Frame> frames = {{callee, callee}};
+    std::optional<Frame> entering = std::nullopt;
+
+    for (const auto& event : trace.events)
+    {
+      const size_t depth = event.call_depth - base_depth;
+      if (depth >= frames.size())
+      {
+        frames.push_back(entering.value_or(frames.back()));
+      }
+      else
+      {
+        frames.resize(depth + 1);
+      }
+
+      ++counts[frames.back().code][static_cast<uint8_t>(event.op)];
+      entering = entered_frame(event, frames.back(), get_nonce);
+    }
+
+    return counts;
+  }
+
+  struct ContractStats
+  {
+    // Executions in which the contract's code ran
+    uint64_t executions = 0;
+
+    // Its share of the time of those executions
+    uint64_t time = 0;
+
+    OpcodeCounts opcodes = {};
+  };
+
+  inline uint64_t total(const OpcodeCounts& counts)
+  {
+    uint64_t n = 0;
+    for (const auto count : counts)
+    {
+      n += count;
+    }
+    return n;
+  }
+
+  class Registry
+  {
+    mutable std::mutex lock;
+    std::map<eevm::Address, ContractStats> by_contract;
+
+  public:
+    void record(const ContractOpcodes& execution, uint64_t time)
+    {
+      uint64_t executed = 0;
+      for (const auto& [address, opcodes] : execution)
+      {
+        executed += total(opcodes);
+      }
+
+      std::lock_guard<std::mutex> guard(lock);
+      for (const auto& [address, opcodes] : execution)
+      {
+        auto& stats = by_contract[address];
+        ++stats.executions;
+        stats.time += static_cast<uint64_t>(
+          static_cast<double>(time) * total(opcodes) / executed);
+        for (size_t i = 0; i < opcodes.size(); ++i)
+        {
+          stats.opcodes[i] += opcodes[i];
+        }
+      }
+    }
+
+    void reset()
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      by_contract.clear();
+    }
+
+    // Keyed by contract address. Opcodes are keyed by their hex-encoded
+    // value, and only those which were executed are listed
+    nlohmann::json to_json() const
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      auto j = nlohmann::json::object();
+      for (const auto& [address, stats] : by_contract)
+      {
+        auto opcodes = nlohmann::json::object();
+        for (size_t i = 0; i < stats.opcodes.size(); ++i)
+        {
+          if (stats.opcodes[i] != 0)
+          {
+            opcodes[hex::to_hex_string(uint64_t(i))] = stats.opcodes[i];
+          }
+        }
+
+        const auto executed = total(stats.opcodes);
+        j[keccak::to_checksum_address(address)] = {
+          {"executions", stats.executions},
+          {"time", stats.time},
+          {"timePerOpcode", executed == 0 ? 0 : stats.time / executed},
+          {"timeUnit", time_unit},
+          {"opcodes", opcodes}};
+      }
+      return j;
+    }
+  };
+} // namespace evm4ccf::opcode_stats
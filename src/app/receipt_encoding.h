@@ -0,0 +1,343 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#pragma once
+
+// EVM-for-CCF
+#include "keccak256.h"
+
+// eEVM
+#include <eEVM/bigint.h>
+#include <eEVM/util.h>
+
+// STL/3rd-party
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Compact encoding of evm4ccf::TxResult, as stored in eth.txresults. Integers
+// are LEB128 varints, 256-bit words are stored without their leading zero
+// bytes, and absent or zero fields are omitted. Every emitting address and
+// topic is stored once per receipt in a dictionary, and logs refer to it by
+// index. Indices below the number of well-known event signatures refer to
+// those signatures, so the common ERC20 and ERC721 events need a single byte.
+//
+// Layout, after the version:
+//   fields                 varint, bitmask of the fields which follow
+//   contract address       word, if has_contract_address
+//   block number           varint, if has_block_number
+//   transaction index      varint, if has_transaction_index
+//   dictionary             varint count, then that many words, if has_logs
+//   logs                   varint count, then each log as the reference of
+//                          its address, a varint count of topic references,
+//                          the topic references, and length-prefixed data
+//
+// This must be included after TxResult is defined.
+namespace evm4ccf::receipts
+{
+  static constexpr uint64_t compact_version = 1;
+
+  enum Fields : uint64_t
+  {
+    has_contract_address = 1 << 0,
+    has_block_number = 1 << 1,
+    has_transaction_index = 1 << 2,
+    has_logs = 1 << 3,
+  };
+
+  // Referred to by index, so this list may only be appended to
+  inline const std::vector<uint256_t>& well_known_topics()
+  {
+    static const std::vector<uint256_t> topics = []() {
+      static constexpr const char* signatures[] = {
+        "Transfer(address,address,uint256)",
+        "Approval(address,address,uint256)",
+        "ApprovalForAll(address,address,bool)"};
+
+      std::vector<CBuffer> inputs;
+      for (const auto signature : signatures)
+      {
+        inputs.push_back({reinterpret_cast<const uint8_t*>(signature),
+                          std::strlen(signature)});
+      }
+
+      std::vector<uint256_t> hashes;
+      for (const auto& h : keccak::keccak_256_many(inputs))
+      {
+        hashes.push_back(eevm::from_big_endian(h.data()));
+      }
+      return hashes;
+    }();
+    return topics;
+  }
+
+  inline void write_varint(std::vector<uint8_t>& out, uint64_t v)
+  {
+    while (v >= 0x80)
+    {
+      out.push_back(static_cast<uint8_t>(v) | 0x80);
+      v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+  }
+
+  inline void write_bytes(
+    std::vector<uint8_t>& out, const uint8_t* data, size_t size)
+  {
+    write_varint(out, size);
+    out.insert(out.end(), data, data + size);
+  }
+
+  inline void write_word(std::vector<uint8_t>& out, const uint256_t& v)
+  {
+    uint8_t bytes[32];
+    eevm::to_big_endian(v, bytes);
+    size_t zeros = 0;
+    while (zeros < sizeof(bytes) && bytes[zeros] == 0)
+    {
+      ++zeros;
+    }
+    write_bytes(out, bytes + zeros, sizeof(bytes) - zeros);
+  }
+
+  class Reader
+  {
+    const uint8_t* data;
+    size_t remaining;
+
+    void require(size_t n) const
+    {
+      if (n > remaining)
+      {
+        throw std::logic_error("Receipt is truncated");
+      }
+    }
+
+  public:
+    Reader(const std::vector<uint8_t>& encoded) :
+      data(encoded.data()),
+      remaining(encoded.size())
+    {}
+
+    // Rejects a count of items which could not fit in the rest of the
+    // encoding, each taking at least min_size bytes, before anything is
+    // allocated for them
+    uint64_t count(size_t min_size)
+    {
+      const auto n = varint();
+      if (n > remaining / min_size)
+      {
+        throw std::logic_error("Receipt is truncated");
+      }
+      return n;
+    }
+
+    uint64_t varint()
+    {
+      uint64_t v = 0;
+      for (unsigned shift = 0; shift < 64; shift += 7)
+      {
+        require(1);
+        const auto b = *data++;
+        --remaining;
+        v |= uint64_t(b & 0x7f) << shift;
+        if ((b & 0x80) == 0)
+        {
+          return v;
+        }
+      }
+      throw std::logic_error("Receipt contains an overlong varint");
+    }
+
+    // A length-prefixed byte string, left in place in the encoding
+    CBuffer bytes_in_place()
+    {
+      const auto size = varint();
+      require(size);
+      const CBuffer out = {data, size};
+      data += size;
+      remaining -= size;
+      return out;
+    }
+
+    std::vector<uint8_t> bytes()
+    {
+      const auto b = bytes_in_place();
+      return {b.p, b.p + b.n};
+    }
+
+    uint256_t word()
+    {
+      const auto b = bytes();
+      if (b.size() > 32)
+      {
+        throw std::logic_error("Receipt contains a word over 32 bytes");
+      }
+      if (b.empty())
+      {
+        return 0;
+      }
+      return eevm::from_big_endian(b.data(), b.size());
+    }
+  };
+
+  // Assigns each distinct word a reference, in order of first use
+  class Dictionary
+  {
+    std::map<uint256_t, uint64_t> references;
+
+  public:
+    std::vector<uint256_t> words;
+
+    uint64_t intern(const uint256_t& w)
+    {
+      const auto& known = well_known_topics();
+      const auto it = std::find(known.begin(), known.end(), w);
+      if (it != known.end())
+      {
+        return it - known.begin();
+      }
+
+      const auto [entry, inserted] =
+        references.emplace(w, known.size() + words.size());
+      if (inserted)
+      {
+        words.push_back(w);
+      }
+      return entry->second;
+    }
+  };
+
+  inline std::vector<uint8_t> encode(const TxResult& r)
+  {
+    uint64_t fields = 0;
+    if (r.contract_address.has_value())
+    {
+      fields |= has_contract_address;
+    }
+    if (r.block_number != 0)
+    {
+      fields |= has_block_number;
+    }
+    if (r.transaction_index != 0)
+    {
+      fields |= has_transaction_index;
+    }
+    if (!r.logs.empty())
+    {
+      fields |= has_logs;
+    }
+
+    std::vector<uint8_t> out;
+    write_varint(out, fields);
+    if (fields & has_contract_address)
+    {
+      write_word(out, *r.contract_address);
+    }
+    if (fields & has_block_number)
+    {
+      write_varint(out, r.block_number);
+    }
+    if (fields & has_transaction_index)
+    {
+      write_varint(out, r.transaction_index);
+    }
+
+    if (fields & has_logs)
+    {
+      Dictionary dictionary;
+      std::vector<uint8_t> logs;
+      write_varint(logs, r.logs.size());
+      for (const auto& log : r.logs)
+      {
+        write_varint(logs, dictionary.intern(log.address));
+        write_varint(logs, log.topic_count);
+        for (size_t i = 0; i < log.topic_count; ++i)
+        {
+          write_varint(logs, dictionary.intern(log.topics[i]));
+        }
+        write_bytes(logs, r.logs.data_of(log), log.data_size);
+      }
+
+      write_varint(out, dictionary.words.size());
+      for (const auto& w : dictionary.words)
+      {
+        write_word(out, w);
+      }
+      out.insert(out.end(), logs.begin(), logs.end());
+    }
+
+    return out;
+  }
+
+  inline TxResult decode(const std::vector<uint8_t>& encoded)
+  {
+    Reader reader(encoded);
+    TxResult r;
+
+    const auto fields = reader.varint();
+    if (fields & has_contract_address)
+    {
+      r.contract_address = reader.word();
+    }
+    if (fields & has_block_number)
+    {
+      r.block_number = reader.varint();
+    }
+    if (fields & has_transaction_index)
+    {
+      r.transaction_index = reader.varint();
+    }
+
+    if (fields & has_logs)
+    {
+      const auto& known = well_known_topics();
+      // Each word takes at least its length byte
+      std::vector<uint256_t> dictionary(reader.count(1));
+      for (auto& w : dictionary)
+      {
+        w = reader.word();
+      }
+
+      auto lookup = [&](uint64_t reference) -> const uint256_t& {
+        if (reference < known.size())
+        {
+          return known[reference];
+        }
+        reference -= known.size();
+        if (reference >= dictionary.size())
+        {
+          throw std::logic_error("Receipt refers to a missing word");
+        }
+        return dictionary[reference];
+      };
+
+      // Each log takes at least an address reference, a topic count and a
+      // data length
+      const auto log_count = reader.count(3);
+      for (size_t n = 0; n < log_count; ++n)
+      {
+        const auto address = lookup(reader.varint());
+        const auto topic_count = reader.varint();
+        if (topic_count > ReceiptLogs::max_topics)
+        {
+          throw std::logic_error("Receipt contains a log with too many topics");
+        }
+
+        std::array<uint256_t, ReceiptLogs::max_topics> topics;
+        for (size_t i = 0; i < topic_count; ++i)
+        {
+          topics[i] = lookup(reader.varint());
+        }
+
+        const auto data = reader.bytes_in_place();
+        r.logs.add(address, topics.data(), topic_count, data.p, data.n);
+      }
+    }
+
+    return r;
+  }
+} // namespace evm4ccf::receipts
@@ -0,0 +1,184 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#pragma once
+
+// eEVM
+#include <eEVM/bigint.h>
+#include <eEVM/transaction.h>
+
+// STL/3rd-party
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace evm4ccf
+{
+  // The logs of one transaction, stored flat. Each entry holds its topics in
+  // fixed inline slots (LOG0 to LOG4 emit at most 4), and its data as a range
+  // of a single buffer shared by every log in the transaction. A receipt's
+  // logs therefore take two allocations, however many there are.
+  class ReceiptLogs
+  {
+  public:
+    static constexpr size_t max_topics = 4;
+
+    struct Entry
+    {
+      eevm::Address address = {};
+      uint8_t topic_count = 0;
+      std::array<uint256_t, max_topics> topics = {};
+      uint64_t data_offset = 0;
+      uint64_t data_size = 0;
+    };
+
+  private:
+    std::vector<Entry> entries;
+    std::vector<uint8_t> data;
+
+  public:
+    ReceiptLogs() = default;
+
+    // So that results can still be built from a list of eEVM's entries
+    ReceiptLogs(const std::vector<eevm::LogEntry>& logs)
+    {
+      entries.reserve(logs.size());
+      for (const auto& log : logs)
+      {
+        add(log);
+      }
+    }
+
+    void add(
+      const eevm::Address& address,
+      const uint256_t* topics,
+      size_t topic_count,
+      const uint8_t* log_data,
+      size_t data_size)
+    {
+      if (topic_count > max_topics)
+      {
+        throw std::logic_error(
+          "Log has " + std::to_string(topic_count) + " topics, at most " +
+          std::to_string(max_topics) + " are allowed");
+      }
+
+      Entry& entry = entries.emplace_back();
+      entry.address = address;
+      entry.topic_count = static_cast<uint8_t>(topic_count);
+      std::copy(topics, topics + topic_count, entry.topics.begin());
+      entry.data_offset = data.size();
+      entry.data_size = data_size;
+      data.insert(data.end(), log_data, log_data + data_size);
+    }
+
+    void add(const eevm::LogEntry& log)
+    {
+      add(
+        log.address,
+        log.topics.data(),
+        log.topics.size(),
+        log.data.data(),
+        log.data.size());
+    }
+
+    size_t size() const
+    {
+      return entries.size();
+    }
+
+    bool empty() const
+    {
+      return entries.empty();
+    }
+
+    const Entry& operator[](size_t i) const
+    {
+      return entries[i];
+    }
+
+    std::vector<Entry>::const_iterator begin() const
+    {
+      return entries.begin();
+    }
+
+    std::vector<Entry>::const_iterator end() const
+    {
+      return entries.end();
+    }
+
+    // Start of an entry's data, which is entry.data_size bytes long
+    const uint8_t* data_of(const Entry& entry) const
+    {
+      return data.data() + entry.data_offset;
+    }
+
+    eevm::LogEntry to_log_entry(const Entry& entry) const
+    {
+      const auto begin = data_of(entry);
+      return {
+        entry.address,
+        {begin, begin + entry.data_size},
+        {entry.topics.begin(), entry.topics.begin() + entry.topic_count}};
+    }
+
+    // Copies out eEVM's form, as returned by eth_getTransactionReceipt
+    std::vector<eevm::LogEntry> to_log_entries() const
+    {
+      std::vector<eevm::LogEntry> logs;
+      logs.reserve(entries.size());
+      for (const auto& entry : entries)
+      {
+        logs.push_back(to_log_entry(entry));
+      }
+      return logs;
+    }
+
+    bool operator==(const ReceiptLogs& other) const
+    {
+      if (entries.size() != other.entries.size())
+      {
+        return false;
+      }
+
+      for (size_t i = 0; i < entries.size(); ++i)
+      {
+        const auto& l = entries[i];
+        const auto& r = other.entries[i];
+        if (
+          l.address != r.address || l.topic_count != r.topic_count ||
+          l.data_size != r.data_size ||
+          !std::equal(
+            l.topics.begin(),
+            l.topics.begin() + l.topic_count,
+            r.topics.begin()) ||
+          !std::equal(
+            data_of(l), data_of(l) + l.data_size, other.data_of(r)))
+        {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    bool operator!=(const ReceiptLogs& other) const
+    {
+      return !(*this == other);
+    }
+  };
+
+  // Collects the logs emitted by a transaction, to be moved into its receipt.
+  // Each entry built by the Processor is copied into the flat layout as it
+  // arrives, and freed by eEVM when the handler returns
+  struct ReceiptLogHandler : public eevm::LogHandler
+  {
+    ReceiptLogs logs;
+
+    void handle(eevm::LogEntry&& log_entry) override
+    {
+      logs.add(log_entry);
+    }
+  };
+} // namespace evm4ccf
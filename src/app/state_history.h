@@ -0,0 +1,289 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#pragma once
+
+// EVM-for-CCF
+#include "tables.h"
+
+// STL/3rd-party
+#include <algorithm>
+#include <optional>
+#include <set>
+#include <vector>
+
+// Version histories let reads be served from the state at the end of a past
+// block, without replaying the ledger. The first write to a key in a block
+// stores the value the key held before that block, and adds the block to
+// the key's index of changes. Each transaction stores the list of keys it
+// wrote, so that everything recorded in a block can be removed when it
+// leaves the retention window. Writes and reads each cost a fixed number of
+// extra KV lookups, however long the retention window is.
+namespace evm4ccf::history
+{
+  // Span of the buckets in which each key's changes are indexed. A read
+  // looks at no more than two of them
+  static constexpr uint64_t bucket_blocks = 32;
+
+  using BlockNumbers = std::vector<uint64_t>;
+
+  // Stores the value a key held before its first write in block, unless an
+  // earlier transaction in the block has already written it
+  template <typename TViews, typename K, typename V>
+  void record(
+    const TViews& views, const K& key, uint64_t block, const V& previous)
+  {
+    const auto versioned = std::make_pair(key, block);
+    if (views.values->get(versioned).has_value())
+    {
+      return;
+    }
+    views.values->put(versioned, previous);
+
+    // Blocks are recorded in increasing order, so the index stays sorted
+    const auto bucket = block / bucket_blocks;
+    const auto bucket_key = std::make_pair(key, bucket);
+    auto changes = views.changes->get(bucket_key).value_or(BlockNumbers{});
+    if (changes.empty())
+    {
+      auto buckets = views.buckets->get(key).value_or(BlockNumbers{});
+      buckets.push_back(bucket);
+      views.buckets->put(key, buckets);
+    }
+    changes.push_back(block);
+    views.changes->put(bucket_key, changes);
+  }
+
+  // Removes what record() stored for a key in block
+  template <typename TViews, typename K>
+  void forget(const TViews& views, const K& key, uint64_t block)
+  {
+    views.values->remove(std::make_pair(key, block));
+
+    const auto bucket = block / bucket_blocks;
+    const auto bucket_key = std::make_pair(key, bucket);
+    auto changes = views.changes->get(bucket_key);
+    if (!changes.has_value())
+    {
+      return;
+    }
+
+    changes->erase(
+      std::remove(changes->begin(), changes->end(), block), changes->end());
+    if (!changes->empty())
+    {
+      views.changes->put(bucket_key, *changes);
+      return;
+    }
+    views.changes->remove(bucket_key);
+
+    auto buckets = views.buckets->get(key);
+    if (!buckets.has_value())
+    {
+      return;
+    }
+
+    buckets->erase(
+      std::remove(buckets->begin(), buckets->end(), bucket), buckets->end());
+    if (buckets->empty())
+    {
+      views.buckets->remove(key);
+    }
+    else
+    {
+      views.buckets->put(key, *buckets);
+    }
+  }
+
+  // Returns the first block after the given one in which key was written, or
+  // nullopt if it has not been written since
+  template <typename TViews, typename K>
+  std::optional<uint64_t> next_change(
+    const TViews& views, const K& key, uint64_t after)
+  {
+    const auto buckets = views.buckets->get(key);
+    if (!buckets.has_value())
+    {
+      return std::nullopt;
+    }
+
+    // The bucket holding `after` may only have changes up to it, in which
+    // case the first change after it is the first in the next bucket
+    auto bucket = std::lower_bound(
+      buckets->begin(), buckets->end(), after / bucket_blocks);
+    for (; bucket != buckets->end(); ++bucket)
+    {
+      const auto changes = views.changes->get(std::make_pair(key, *bucket));
+      if (!changes.has_value())
+      {
+        continue;
+      }
+
+      const auto change =
+        std::upper_bound(changes->begin(), changes->end(), after);
+      if (change != changes->end())
+      {
+        return *change;
+      }
+    }
+
+    return std::nullopt;
+  }
+
+  // Records writes made by a transaction in the given block
+  class Recorder
+  {
+    tables::History::Views views;
+    uint64_t block;
+
+    // Keys written by this transaction, whose previous values have been
+    // recorded
+    std::set<eevm::Address> balances;
+    std::set<eevm::Address> codes;
+    std::set<eevm::Address> nonces;
+    std::set<tables::StorageKey> storage_keys;
+
+    template <typename TViews, typename K, typename V>
+    void record_in(
+      const TViews& history,
+      std::set<K>& written,
+      const K& key,
+      const V& previous)
+    {
+      if (written.insert(key).second)
+      {
+        record(history, key, block, previous);
+      }
+    }
+
+  public:
+    Recorder(const tables::History::Views& views, uint64_t block) :
+      views(views),
+      block(block)
+    {}
+
+    // An account created in this block did not exist before it. Its balance
+    // is also recorded, which lists it in this transaction's delta
+    void created(const eevm::Address& address)
+    {
+      views.created->put(address, block);
+      balance(address, 0);
+    }
+
+    void balance(const eevm::Address& address, const uint256_t& previous)
+    {
+      record_in(views.balances, balances, address, previous);
+    }
+
+    void code(const eevm::Address& address, const eevm::Code& previous)
+    {
+      record_in(views.codes, codes, address, previous);
+    }
+
+    void nonce(
+      const eevm::Address& address, const eevm::Account::Nonce& previous)
+    {
+      record_in(views.nonces, nonces, address, previous);
+    }
+
+    void storage(const tables::StorageKey& key, const uint256_t& previous)
+    {
+      record_in(views.storage, storage_keys, key, previous);
+    }
+
+    // Stores the keys written by this transaction, which is at the given
+    // index in its block
+    void write_delta(uint64_t transaction_index)
+    {
+      if (
+        balances.empty() && codes.empty() && nonces.empty() &&
+        storage_keys.empty())
+      {
+        return;
+      }
+
+      HistoryDelta delta;
+      delta.balances.assign(balances.begin(), balances.end());
+      delta.codes.assign(codes.begin(), codes.end());
+      delta.nonces.assign(nonces.begin(), nonces.end());
+      delta.storage.assign(storage_keys.begin(), storage_keys.end());
+      views.deltas->put(std::make_pair(block, transaction_index), delta);
+    }
+  };
+
+  // Removes everything recorded by the transactions of a block. Called once
+  // no read can reach the state before that block
+  inline void prune(
+    const tables::History::Views& views,
+    uint64_t block,
+    size_t transaction_count)
+  {
+    for (uint64_t index = 0; index < transaction_count; ++index)
+    {
+      const auto delta_key = std::make_pair(block, index);
+      const auto delta = views.deltas->get(delta_key);
+      if (!delta.has_value())
+      {
+        continue;
+      }
+
+      for (const auto& address : delta->balances)
+      {
+        forget(views.balances, address, block);
+
+        const auto created = views.created->get(address);
+        if (created.has_value() && *created == block)
+        {
+          views.created->remove(address);
+        }
+      }
+      for (const auto& address : delta->codes)
+      {
+        forget(views.codes, address, block);
+      }
+      for (const auto& address : delta->nonces)
+      {
+        forget(views.nonces, address, block);
+      }
+      for (const auto& key : delta->storage)
+      {
+        forget(views.storage, key, block);
+      }
+      views.deltas->remove(delta_key);
+    }
+  }
+
+  // A past block whose state is being read
+  struct PastState
+  {
+    tables::History::Views views;
+    uint64_t block;
+  };
+
+  // Reads the value of key at the end of a past block. This is the value
+  // recorded by the key's first write in any later block, or its current
+  // value if it has not been written since
+  template <typename TViews, typename K, typename F>
+  auto read_at(
+    const TViews& history, const K& key, const PastState& past, F&& current)
+  {
+    const auto block = next_change(history, key, past.block);
+    if (block.has_value())
+    {
+      const auto previous = history.values->get(std::make_pair(key, *block));
+      if (previous.has_value())
+      {
+        return *previous;
+      }
+    }
+
+    return current();
+  }
+
+  // Whether an account which exists now also existed at the end of a past
+  // block
+  inline bool existed_at(const eevm::Address& address, const PastState& past)
+  {
+    const auto created = past.views.created->get(address);
+    return !created.has_value() || *created <= past.block;
+  }
+} // namespace evm4ccf::history
@@ -3,6 +3,7 @@
 #pragma once
 
 // EVM-for-CCF
+#include "receipt_logs.h"
 #include "rpc_types.h"
 
 // CCF
@@ -14,6 +15,7 @@
 #include <eEVM/address.h>
 
 // STL/3rd-party
+#include <set>
 #include <vector>
 
 namespace evm4ccf
@@ -21,10 +23,43 @@ namespace evm4ccf
   struct TxResult
   {
     std::optional<eevm::Address> contract_address;
-    std::vector<eevm::LogEntry> logs;
+    ReceiptLogs logs;
+
+    // Position of the transaction in its pseudo-block
+    uint64_t block_number = 0;
+    uint64_t transaction_index = 0;
+  };
+
+  // Keys written by one transaction, so that the version history entries it
+  // created can be found and removed once its block is no longer readable
+  struct HistoryDelta
+  {
+    std::vector<eevm::Address> balances;
+    std::vector<eevm::Address> codes;
+    std::vector<eevm::Address> nonces;
+    std::vector<std::pair<eevm::Address, uint256_t>> storage;
+  };
+
+  // Tracing settings, shared by every node. Each change stores a new
+  // generation, so that nodes only reconfigure when it differs from theirs
+  struct TracingSettings
+  {
+    uint64_t generation = 0;
+    size_t sample_every = 0;
+    size_t tail_length = 0;
+    std::set<eevm::Address> addresses;
+  };
+
+  // A signed transaction which arrived before its sender's earlier nonces
+  // had executed, kept in its raw form until it can run
+  struct QueuedTransaction
+  {
+    std::vector<uint8_t> raw;
+    bool trace = false;
   };
 } // namespace evm4ccf
 
+#include "receipt_encoding.h"
 #include "msgpacktypes.h"
 #include "nljsontypes.h"
 
@@ -46,7 +81,27 @@ namespace evm4ccf
 {
   inline bool operator==(const TxResult& l, const TxResult& r)
   {
-    return l.contract_address == r.contract_address && l.logs == r.logs;
+    return l.contract_address == r.contract_address && l.logs == r.logs &&
+      l.block_number == r.block_number &&
+      l.transaction_index == r.transaction_index;
+  }
+
+  inline bool operator==(const HistoryDelta& l, const HistoryDelta& r)
+  {
+    return l.balances == r.balances && l.codes == r.codes &&
+      l.nonces == r.nonces && l.storage == r.storage;
+  }
+
+  inline bool operator==(const TracingSettings& l, const TracingSettings& r)
+  {
+    return l.generation == r.generation && l.sample_every == r.sample_every &&
+      l.tail_length == r.tail_length && l.addresses == r.addresses;
+  }
+
+  inline bool operator==(
+    const QueuedTransaction& l, const QueuedTransaction& r)
+  {
+    return l.raw == r.raw && l.trace == r.trace;
   }
 
   namespace tables
@@ -78,6 +133,137 @@ namespace evm4ccf
     using StorageKey = std::pair<eevm::Address, uint256_t>;
     using Storage = ccf::Store::Map<StorageKey, uint256_t>;
 
+    // Version history of the tables above, for reads at past blocks. When a
+    // key is first written in a block, the value it held before that block
+    // is stored under the key and that block's number
+    template <typename K>
+    using Versioned = std::pair<K, uint64_t>;
+
+    template <typename K, typename V>
+    struct VersionHistory
+    {
+      using Values = ccf::Store::Map<Versioned<K>, V>;
+      Values& values;
+
+      // Blocks in which each key was written, in order. They are indexed in
+      // buckets of consecutive blocks, by key and bucket number, so that no
+      // entry grows with the retention window
+      using Changes = ccf::Store::Map<Versioned<K>, std::vector<uint64_t>>;
+      Changes& changes;
+
+      // Numbers of the buckets holding each key's changes, in order
+      using Buckets = ccf::Store::Map<K, std::vector<uint64_t>>;
+      Buckets& buckets;
+
+      struct Views
+      {
+        typename Values::TxView* values;
+        typename Changes::TxView* changes;
+        typename Buckets::TxView* buckets;
+      };
+
+      Views get_views(ccf::Store::Tx& tx)
+      {
+        return {
+          tx.get_view(values), tx.get_view(changes), tx.get_view(buckets)};
+      }
+
+      static VersionHistory create(ccf::Store& store, const std::string& name)
+      {
+        return {store.create<Values>(name),
+                store.create<Changes>(name + ".changes"),
+                store.create<Buckets>(name + ".buckets")};
+      }
+    };
+
+    struct History
+    {
+      using Balances = VersionHistory<eevm::Address, uint256_t>;
+      Balances balances;
+
+      using Codes = VersionHistory<eevm::Address, eevm::Code>;
+      Codes codes;
+
+      using Nonces = VersionHistory<eevm::Address, eevm::Account::Nonce>;
+      Nonces nonces;
+
+      using Storage = VersionHistory<StorageKey, uint256_t>;
+      Storage storage;
+
+      // Block in which each account created since the oldest readable block
+      // was created. It did not exist in the state before that block
+      using Created = ccf::Store::Map<eevm::Address, uint64_t>;
+      Created& created;
+
+      // Keys written by each transaction, by block number and index
+      using Deltas =
+        ccf::Store::Map<std::pair<uint64_t, uint64_t>, HistoryDelta>;
+      Deltas& deltas;
+
+      struct Views
+      {
+        Balances::Views balances;
+        Codes::Views codes;
+        Nonces::Views nonces;
+        Storage::Views storage;
+        Created::TxView* created;
+        Deltas::TxView* deltas;
+      };
+
+      Views get_views(ccf::Store::Tx& tx)
+      {
+        return {balances.get_views(tx),
+                codes.get_views(tx),
+                nonces.get_views(tx),
+                storage.get_views(tx),
+                tx.get_view(created),
+                tx.get_view(deltas)};
+      }
+    };
+
     using Results = ccf::Store::Map<TxHash, TxResult>;
+
+    // Results evicted from Results, held in their compact encoding rather
+    // than as TxResults. Written once when a result is evicted, and never
+    // changed, so the archive is append-only
+    using ArchivedResults = ccf::Store::Map<TxHash, std::vector<uint8_t>>;
+
+    // Sealed blocks, by number
+    using Blocks = ccf::Store::Map<uint64_t, BlockHeader>;
+
+    // The single block currently collecting transactions. Its hash is not
+    // set until it is sealed and moved to Blocks
+    using PendingBlock = ccf::Store::Map<uint8_t, BlockHeader>;
+    static constexpr uint8_t pending_block_key = 0;
+
+    // Users who may call the app's diagnostic RPCs, and the address each of
+    // them transacts from. Only written by governance
+    using Operators = ccf::Store::Map<ccf::CallerId, eevm::Address>;
+
+    using Tracing = ccf::Store::Map<uint8_t, TracingSettings>;
+    static constexpr uint8_t tracing_key = 0;
+
+    // Transactions waiting for their sender's earlier nonces, by sender and
+    // nonce, and the number each sender has waiting
+    struct TransactionQueue
+    {
+      using Key = std::pair<eevm::Address, uint64_t>;
+      using Queued = ccf::Store::Map<Key, QueuedTransaction>;
+      Queued& queued;
+
+      using Counts = ccf::Store::Map<eevm::Address, uint64_t>;
+      Counts& counts;
+
+      struct Views
+      {
+        Queued::TxView* queued;
+        Counts::TxView* counts;
+      };
+
+      Views get_views(ccf::Store::Tx& tx)
+      {
+        return {tx.get_view(queued), tx.get_view(counts)};
+      }
+    };
   } // namespace tables
 } // namespace evm4ccf
@@ -0,0 +1,143 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#pragma once
+
+// EVM-for-CCF
+#include "keccak256.h"
+
+// eEVM
+#include <eEVM/address.h>
+#include <eEVM/trace.h>
+#include <eEVM/util.h>
+
+// STL/3rd-party
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <set>
+#include <sstream>
+
+// Runtime selection of which EVM executions are traced. Tracing is expensive,
+// so by default nothing is traced. An operator can instead trace 1 in every K
+// executions, and always trace executions sent from or to their own address,
+// and any request can ask for its own execution to be traced. When a traced
+// execution fails, only the last few steps of its trace are kept, in memory,
+// for operators to read.
+namespace evm4ccf::tracing
+{
+  // Number of failing trace tails kept by each node
+  static constexpr size_t max_failures = 16;
+
+  class Sampler
+  {
+    std::atomic<size_t> sample_every;
+    std::atomic<size_t> tail_length;
+
+    // Generation of the settings currently applied. 0 is the build's
+    // defaults, which apply until settings are first stored
+    std::atomic<uint64_t> generation = 0;
+
+    std::atomic<size_t> executions = 0;
+    std::atomic<size_t> traced = 0;
+
+    // Checked before taking the lock, so that executions pay nothing for
+    // forced tracing until an address is added
+    std::atomic<bool> any_forced = false;
+    mutable std::mutex lock;
+    std::set<eevm::Address> forced;
+    std::deque<std::string> failures;
+
+  public:
+    Sampler(size_t sample_every_, size_t tail_length_) :
+      sample_every(sample_every_),
+      tail_length(tail_length_)
+    {}
+
+    // Applies a generation of the settings, unless it is already applied. A
+    // sample_every of 0 disables sampling
+    void configure(
+      uint64_t generation_,
+      size_t sample_every_,
+      size_t tail_length_,
+      const std::set<eevm::Address>& forced_)
+    {
+      if (generation.load(std::memory_order_acquire) == generation_)
+      {
+        return;
+      }
+
+      std::lock_guard<std::mutex> guard(lock);
+      sample_every.store(sample_every_, std::memory_order_relaxed);
+      tail_length.store(tail_length_, std::memory_order_relaxed);
+      forced = forced_;
+      any_forced.store(!forced.empty(), std::memory_order_relaxed);
+      generation.store(generation_, std::memory_order_release);
+    }
+
+    // A request may force its own execution to be traced
+    bool should_trace(
+      const eevm::Address& from,
+      const eevm::Address& to,
+      bool requested = false)
+    {
+      bool trace = requested;
+
+      const auto k = sample_every.load(std::memory_order_relaxed);
+      if (!trace && k != 0)
+      {
+        trace = executions.fetch_add(1, std::memory_order_relaxed) % k == 0;
+      }
+
+      if (!trace && any_forced.load(std::memory_order_relaxed))
+      {
+        std::lock_guard<std::mutex> guard(lock);
+        trace = forced.find(from) != forced.end() ||
+          forced.find(to) != forced.end();
+      }
+
+      if (trace)
+      {
+        traced.fetch_add(1, std::memory_order_relaxed);
+      }
+      return trace;
+    }
+
+    // The last steps of a trace, formatted for logging
+    std::string tail(const eevm::Trace& tr) const
+    {
+      std::stringstream ss;
+      tr.print_last_n(ss, tail_length.load(std::memory_order_relaxed));
+      return ss.str();
+    }
+
+    // Keeps the tail of a failing trace, dropping the oldest once
+    // max_failures are kept
+    void record_failure(const eevm::Trace& tr)
+    {
+      auto t = tail(tr);
+      std::lock_guard<std::mutex> guard(lock);
+      if (failures.size() == max_failures)
+      {
+        failures.pop_front();
+      }
+      failures.push_back(std::move(t));
+    }
+
+    nlohmann::json to_json() const
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      auto addresses = nlohmann::json::array();
+      for (const auto& a : forced)
+      {
+        addresses.push_back(keccak::to_checksum_address(a));
+      }
+
+      return {{"sampleEvery", sample_every.load(std::memory_order_relaxed)},
+              {"tailLength", tail_length.load(std::memory_order_relaxed)},
+              {"addresses", addresses},
+              {"traced", traced.load(std::memory_order_relaxed)},
+              {"failures", failures}};
+    }
+  };
+} // namespace evm4ccf::tracing
@@ -0,0 +1,117 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#include "../src/app/arena.h"
+
+#include <doctest/doctest.h>
+#include <map>
+
+using namespace evm4ccf;
+
+TEST_CASE("Allocation" * doctest::test_suite("arena"))
+{
+  Arena arena;
+
+  {
+    INFO("Allocations are aligned, and start in the inline buffer");
+    auto a = arena.allocate(1, 1);
+    auto b = arena.allocate(8, 8);
+    auto c = arena.allocate(32, 32);
+    REQUIRE(a != b);
+    REQUIRE(reinterpret_cast<uintptr_t>(b) % 8 == 0);
+    REQUIRE(reinterpret_cast<uintptr_t>(c) % 32 == 0);
+    REQUIRE(arena.get_allocations() == 3);
+    REQUIRE(arena.get_heap_blocks() == 0);
+  }
+
+  {
+    INFO("Heap blocks are added once the inline buffer is full");
+    for (size_t i = 0; i < Arena::inline_size / 64; ++i)
+    {
+      arena.allocate(64, 8);
+    }
+    REQUIRE(arena.get_heap_blocks() == 1);
+
+    INFO("Allocations larger than a block get a block of their own");
+    auto big = static_cast<uint8_t*>(
+      arena.allocate(16 * Arena::inline_size, alignof(std::max_align_t)));
+    std::fill(big, big + 16 * Arena::inline_size, 0xff);
+    REQUIRE(arena.get_heap_blocks() == 2);
+  }
+}
+
+TEST_CASE("Containers" * doctest::test_suite("arena"))
+{
+  using Map = std::map<
+    size_t,
+    size_t,
+    std::less<size_t>,
+    ArenaAllocator<std::pair<const size_t, size_t>>>;
+
+  {
+    INFO("Containers can allocate from an arena");
+    Arena arena;
+    Map m(&arena);
+    for (size_t i = 0; i < 100; ++i)
+    {
+      m[i] = i * i;
+    }
+    m.erase(50);
+    REQUIRE(m.size() == 99);
+    REQUIRE(m[9] == 81);
+    REQUIRE(arena.get_allocations() == 100);
+  }
+
+  {
+    INFO("Without an arena, containers use the heap");
+    Map m;
+    for (size_t i = 0; i < 100; ++i)
+    {
+      m[i] = i * i;
+    }
+    REQUIRE(m[9] == 81);
+  }
+}
+
+TEST_CASE("Block reuse" * doctest::test_suite("arena"))
+{
+  BlockPool pool;
+
+  auto fill = [](Arena& arena) {
+    for (size_t i = 0; i < 4 * Arena::inline_size / 64; ++i)
+    {
+      arena.allocate(64, 8);
+    }
+  };
+
+  {
+    INFO("The first arena allocates its blocks, and returns them to the pool");
+    Arena arena(pool);
+    fill(arena);
+    REQUIRE(arena.get_heap_blocks() == 2);
+  }
+  REQUIRE(pool.get_allocated_blocks() == 2);
+  REQUIRE(pool.get_reused_blocks() == 0);
+  REQUIRE(pool.get_free_blocks() == 2);
+
+  {
+    INFO("Later arenas of the same size allocate nothing");
+    for (size_t i = 0; i < 10; ++i)
+    {
+      Arena arena(pool);
+      fill(arena);
+      REQUIRE(arena.get_heap_blocks() == 2);
+    }
+    REQUIRE(pool.get_allocated_blocks() == 2);
+    REQUIRE(pool.get_reused_blocks() == 20);
+  }
+
+  {
+    INFO("Blocks too large for the pool are freed");
+    {
+      Arena arena(pool);
+      arena.allocate(2 * BlockPool::max_bytes, 8);
+    }
+    REQUIRE(pool.get_allocated_blocks() == 3);
+    REQUIRE(pool.get_free_blocks() == 2);
+  }
+}
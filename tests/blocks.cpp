@@ -0,0 +1,223 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#include "../src/app/blocks.h"
+#include "shared.h"
+
+#include <doctest/doctest.h>
+
+using namespace ccf;
+using namespace evm4ccf;
+
+TEST_CASE("Blocks0" * doctest::test_suite("blocks"))
+{
+  NetworkTables nwt;
+  StubNotifier stubn;
+  Store& tables = *nwt.tables;
+  auto cert = setup_tables(tables);
+  Ethereum frontend = ccfapp::get_rpc_handler(nwt, stubn);
+  jsonrpc::SeqNo sn = 0;
+
+  auto get_block_number = [&]() {
+    auto in = ethrpc::BlockNumber::make(sn++);
+    const ethrpc::BlockNumber::Out out = do_rpc(frontend, cert, in);
+    return eevm::to_uint64(out.result);
+  };
+
+  auto get_block = [&](const BlockID& id) {
+    auto in = ethrpc::GetBlockByNumber::make(sn++);
+    in.params.block_id = id;
+    const ethrpc::GetBlockByNumber::Out out = do_rpc(frontend, cert, in);
+    return out.result;
+  };
+
+  {
+    INFO("Only the genesis block exists before the first transaction");
+    REQUIRE(get_block_number() == 0);
+
+    const auto genesis = get_block("latest");
+    REQUIRE(genesis.has_value());
+    REQUIRE(genesis == get_block("0x0"));
+    REQUIRE(genesis->number == 0);
+    REQUIRE(genesis->parent_hash == 0);
+    REQUIRE(genesis->transactions.empty());
+    REQUIRE(genesis->block_hash != 0);
+
+    const auto pending = get_block("pending");
+    REQUIRE(pending.has_value());
+    REQUIRE(pending->number == 1);
+    REQUIRE(pending->parent_hash == genesis->block_hash);
+    REQUIRE(pending->transactions.empty());
+  }
+
+  const auto compiled = read_bytecode("SimpleStore");
+  const auto add2 = abi_append(compiled.hashes["add(uint256)"], 2);
+
+  TestAccount owner(frontend, tables);
+
+  TxHash deploy_hash;
+  const auto contract =
+    owner.deploy_contract(abi_append(compiled.deploy, 15), &deploy_hash);
+
+  std::vector<TxHash> tx_hashes = {deploy_hash};
+  for (size_t i = 0; i < 4; ++i)
+  {
+    tx_hashes.push_back(owner.contract_transact(contract, add2));
+  }
+
+  {
+    INFO("By default, each transaction is sealed in its own block");
+    REQUIRE(get_block_number() == tx_hashes.size());
+
+    BlockHash parent_hash = genesis_block().block_hash;
+    for (size_t i = 0; i < tx_hashes.size(); ++i)
+    {
+      const auto block = get_block(eevm::to_hex_string(i + 1));
+      REQUIRE(block.has_value());
+      REQUIRE(block->number == i + 1);
+      REQUIRE(block->parent_hash == parent_hash);
+      REQUIRE(block->transactions == std::vector<TxHash>{tx_hashes[i]});
+      REQUIRE(block->block_hash == compute_block_hash(*block));
+      parent_hash = block->block_hash;
+
+      auto in = ethrpc::GetTransactionReceipt::make(sn++);
+      in.params.tx_hash = tx_hashes[i];
+      const ethrpc::GetTransactionReceipt::Out out =
+        do_rpc(frontend, cert, in);
+      REQUIRE(out.result.has_value());
+      REQUIRE(out.result->block_number == i + 1);
+      REQUIRE(out.result->transaction_index == 0);
+      REQUIRE(out.result->block_hash == block->block_hash);
+    }
+
+    REQUIRE(get_block("earliest") == get_block("0x0"));
+    REQUIRE(
+      get_block("latest") ==
+      get_block(eevm::to_hex_string(tx_hashes.size())));
+    REQUIRE(!get_block(eevm::to_hex_string(tx_hashes.size() + 1)).has_value());
+  }
+
+  {
+    INFO("Full transaction objects are not available");
+    auto in = ethrpc::GetBlockByNumber::make(sn++);
+    in.params.block_id = "latest";
+    in.params.full_transactions = true;
+    do_rpc(frontend, cert, in, false);
+  }
+}
+
+TEST_CASE("BlockBuilder" * doctest::test_suite("blocks"))
+{
+  Store store;
+  auto& blocks = store.create<tables::Blocks>("eth.blocks");
+  auto& pending = store.create<tables::PendingBlock>("eth.blocks.pending");
+
+  constexpr size_t transactions_per_block = 3;
+  constexpr size_t n_transactions = 8;
+
+  for (size_t i = 0; i < n_transactions; ++i)
+  {
+    Store::Tx tx;
+    BlockBuilder builder(tx.get_view(blocks), tx.get_view(pending));
+    const auto [number, index] =
+      builder.add_transaction(i + 1, transactions_per_block);
+    REQUIRE(number == i / transactions_per_block + 1);
+    REQUIRE(index == i % transactions_per_block);
+    REQUIRE(tx.commit() == kv::CommitSuccess::OK);
+  }
+
+  Store::Tx tx;
+  BlockBuilder builder(tx.get_view(blocks), tx.get_view(pending));
+
+  // Two full blocks have been sealed after genesis, and the third is still
+  // collecting
+  REQUIRE(builder.latest_number() == 2);
+  REQUIRE(builder.get_sealed(0) == genesis_block());
+
+  const auto first = builder.get_sealed(1);
+  REQUIRE(first.has_value());
+  REQUIRE(first->parent_hash == genesis_block().block_hash);
+  REQUIRE(first->transactions == std::vector<TxHash>{1, 2, 3});
+
+  const auto second = builder.get_sealed(2);
+  REQUIRE(second.has_value());
+  REQUIRE(second->parent_hash == first->block_hash);
+  REQUIRE(second->transactions == std::vector<TxHash>{4, 5, 6});
+
+  const auto open = builder.get_pending();
+  REQUIRE(open.number == 3);
+  REQUIRE(open.parent_hash == second->block_hash);
+  REQUIRE(open.transactions == std::vector<TxHash>{7, 8});
+  REQUIRE(open.block_hash == 0);
+  REQUIRE(!builder.get_sealed(3).has_value());
+
+  REQUIRE_THROWS(builder.get_by_id("12"));
+}
+
+TEST_CASE("Result retention" * doctest::test_suite("blocks"))
+{
+  Store store;
+  auto& blocks = store.create<tables::Blocks>("eth.blocks");
+  auto& pending = store.create<tables::PendingBlock>("eth.blocks.pending");
+  auto& results = store.create<tables::Results>("eth.txresults");
+  auto& archive =
+    store.create<tables::ArchivedResults>("eth.txresults.archive");
+
+  constexpr size_t transactions_per_block = 2;
+  constexpr uint64_t retention = 2;
+  constexpr size_t n_transactions = 9;
+
+  for (size_t i = 0; i < n_transactions; ++i)
+  {
+    Store::Tx tx;
+    BlockBuilder builder(tx.get_view(blocks), tx.get_view(pending));
+    auto results_view = tx.get_view(results);
+    auto archive_view = tx.get_view(archive);
+
+    const TxHash tx_hash = i + 1;
+    const auto [number, index] =
+      builder.add_transaction(tx_hash, transactions_per_block);
+    results_view->put(tx_hash, TxResult{std::nullopt, {}, number, index});
+
+    if (index + 1 == transactions_per_block)
+    {
+      const auto archived = evict_results(
+        builder, results_view, archive_view, number, retention);
+      REQUIRE(archived == (number <= retention ? 0 : transactions_per_block));
+    }
+    REQUIRE(tx.commit() == kv::CommitSuccess::OK);
+  }
+
+  Store::Tx tx;
+  auto results_view = tx.get_view(results);
+  auto archive_view = tx.get_view(archive);
+
+  {
+    INFO("Results of the most recent sealed blocks are kept");
+    // Blocks 1 to 4 are sealed, and block 5 is pending
+    for (TxHash tx_hash = 5; tx_hash <= n_transactions; ++tx_hash)
+    {
+      REQUIRE(results_view->get(tx_hash).has_value());
+      REQUIRE(!archive_view->get(tx_hash).has_value());
+    }
+  }
+
+  {
+    INFO("Results of older blocks are moved to the archive");
+    for (TxHash tx_hash = 1; tx_hash < 5; ++tx_hash)
+    {
+      REQUIRE(!results_view->get(tx_hash).has_value());
+      const auto archived = archive_view->get(tx_hash);
+      REQUIRE(archived.has_value());
+
+      const auto result = receipts::decode(*archived);
+      REQUIRE(result.block_number == (tx_hash - 1) / 2 + 1);
+      REQUIRE(result.transaction_index == (tx_hash - 1) % 2);
+    }
+  }
+
+  {
+    INFO("A retention of 0 keeps every result");
+    BlockBuilder builder(tx.get_view(blocks), tx.get_view(pending));
+    REQUIRE(evict_results(builder, results_view, archive_view, 3, 0) == 0);
+  }
+}
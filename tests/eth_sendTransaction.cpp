@@ -456,3 +456,223 @@ TEST_CASE("SendTransaction2" * doctest::test_suite("transactions"))
       get_result_value(chairperson.contract_call(ballot, winning_proposal)));
   }
 }
+
+TEST_CASE("SendTransaction3" * doctest::test_suite("transactions"))
+{
+  // Transactions and calls may name the state they touch in an EIP-2930
+  // access list, which is loaded before execution starts
+  NetworkTables nwt;
+  StubNotifier stubn;
+  Store& tables = *nwt.tables;
+  auto cert = setup_tables(tables);
+  Ethereum frontend = ccfapp::get_rpc_handler(nwt, stubn);
+  jsonrpc::SeqNo sn = 0;
+
+  const auto compiled = read_bytecode("SimpleStore");
+  TestAccount owner(frontend, tables);
+  const auto contract = owner.deploy_contract(abi_append(compiled.deploy, 1));
+
+  // Accounts which do not exist are skipped
+  const AccessList access_list = {{contract, {0}}, {0xdead, {0, 1}}};
+
+  auto get = [&]() {
+    auto in = ethrpc::Call::make(sn++);
+    in.params.call_data.from = owner.address;
+    in.params.call_data.to = contract;
+    in.params.call_data.data = compiled.hashes["get()"];
+    in.params.call_data.type = access_list_transaction_type;
+    in.params.call_data.access_list = access_list;
+    const ethrpc::Call::Out out = do_rpc(frontend, cert, in);
+    return get_result_value(out.result);
+  };
+  CHECK(get() == 1);
+
+  size_t nonce = 1;
+  auto send = [&](const std::string& data) {
+    MessageCall mc;
+    mc.to = contract;
+    mc.data = eevm::to_bytes(data);
+    mc.type = access_list_transaction_type;
+    mc.access_list = access_list;
+    auto in = ethrpc::SendRawTransaction::make(sn++);
+    in.params.raw_transaction = owner.sign_transaction(nonce++, mc);
+    const ethrpc::SendRawTransaction::Out out =
+      do_rpc(frontend, owner.cert, in);
+    return out.result;
+  };
+
+  {
+    INFO("Access list transactions are executed");
+    send(abi_append(compiled.hashes["set(uint256)"], 42));
+    CHECK(get() == 42);
+  }
+
+  {
+    INFO("Prefetched slots see writes made during execution");
+    // add() reads the prefetched slot before writing it
+    send(abi_append(compiled.hashes["add(uint256)"], 3));
+    send(abi_append(compiled.hashes["add(uint256)"], 4));
+    CHECK(get() == 49);
+  }
+
+  {
+    INFO("Access list transactions have their own hashes");
+    const auto tx_hash = send(abi_append(compiled.hashes["add(uint256)"], 0));
+    auto in = ethrpc::GetTransactionReceipt::make(sn++);
+    in.params.tx_hash = tx_hash;
+    const ethrpc::GetTransactionReceipt::Out out = do_rpc(frontend, cert, in);
+    REQUIRE(out.result.has_value());
+    CHECK(out.result->transaction_hash == tx_hash);
+  }
+}
+
+TEST_CASE("SendTransaction4" * doctest::test_suite("transactions"))
+{
+  // Signed transactions must not reuse a nonce. Those ahead of the sender's
+  // next nonce are queued and executed in nonce order once the gap is filled,
+  // so a sender may pipeline several of them in any order
+  NetworkTables nwt;
+  StubNotifier stubn;
+  Store& tables = *nwt.tables;
+  auto cert = setup_tables(tables);
+  Ethereum frontend = ccfapp::get_rpc_handler(nwt, stubn);
+  jsonrpc::SeqNo sn = 0;
+
+  const auto compiled = read_bytecode("SimpleStore");
+  TestAccount owner(frontend, tables);
+  const auto contract = owner.deploy_contract(abi_append(compiled.deploy, 1));
+
+  auto send_data =
+    [&](size_t nonce, const std::string& data, bool expect_success = true) {
+      MessageCall mc;
+      mc.to = contract;
+      mc.data = eevm::to_bytes(data);
+      auto in = ethrpc::SendRawTransaction::make(sn++);
+      in.params.raw_transaction = owner.sign_transaction(nonce, mc);
+      return do_rpc(frontend, owner.cert, in, expect_success);
+    };
+
+  auto send = [&](size_t nonce, size_t n, bool expect_success = true) {
+    return send_data(
+      nonce, abi_append(compiled.hashes["add(uint256)"], n), expect_success);
+  };
+
+  auto get = [&]() {
+    auto in = ethrpc::Call::make(sn++);
+    in.params.call_data.to = contract;
+    in.params.call_data.data = compiled.hashes["get()"];
+    const ethrpc::Call::Out out = do_rpc(frontend, cert, in);
+    return get_result_value(out.result);
+  };
+
+  auto get_nonce = [&](const std::string& block_id = "pending") {
+    auto in = ethrpc::GetTransactionCount::make(sn++);
+    in.params.address = owner.address;
+    in.params.block_id = block_id;
+    const ethrpc::GetTransactionCount::Out out = do_rpc(frontend, cert, in);
+    return out.result;
+  };
+
+  auto get_receipt = [&](const TxHash& tx_hash) {
+    auto in = ethrpc::GetTransactionReceipt::make(sn++);
+    in.params.tx_hash = tx_hash;
+    const ethrpc::GetTransactionReceipt::Out out = do_rpc(frontend, cert, in);
+    return out.result;
+  };
+
+  REQUIRE(get_nonce() == 1);
+
+  {
+    INFO("Transactions sent in nonce order are executed");
+    send(1, 2);
+    send(2, 3);
+    REQUIRE(get() == 6);
+    REQUIRE(get_nonce() == 3);
+  }
+
+  {
+    INFO("Replayed transactions are rejected");
+    send(2, 3, false);
+    send(0, 3, false);
+    REQUIRE(get() == 6);
+    REQUIRE(get_nonce() == 3);
+  }
+
+  {
+    INFO("Transactions ahead of the next nonce are queued");
+    const ethrpc::SendRawTransaction::Out queued = send(4, 4);
+    REQUIRE(get() == 6);
+    REQUIRE(get_nonce() == 4);
+    REQUIRE(get_nonce("latest") == 3);
+    REQUIRE(!get_receipt(queued.result).has_value());
+
+    INFO("A queued nonce cannot be queued again");
+    send(4, 5, false);
+    REQUIRE(get_nonce() == 4);
+
+    INFO("Queued transactions execute once the gap is filled");
+    send(3, 3);
+    REQUIRE(get() == 13);
+    REQUIRE(get_nonce() == 5);
+    REQUIRE(get_nonce("latest") == 5);
+
+    INFO("Queued transactions execute under the acknowledged hash");
+    const auto receipt = get_receipt(queued.result);
+    REQUIRE(receipt.has_value());
+    REQUIRE(receipt->transaction_hash == queued.result);
+  }
+
+  {
+    INFO("Queued transactions drain in nonce order, whatever the send order");
+    send(8, 3);
+    send(6, 1);
+    send(7, 2);
+    REQUIRE(get() == 13);
+    REQUIRE(get_nonce() == 8);
+
+    send(5, 4);
+    REQUIRE(get() == 23);
+    REQUIRE(get_nonce("latest") == 9);
+  }
+
+  {
+    INFO("Transactions too far ahead are rejected");
+    // The default QUEUED_TRANSACTIONS_PER_SENDER
+    send(9 + 64, 1, false);
+    REQUIRE(get_nonce() == 9);
+  }
+
+  {
+    INFO("A failing queued transaction is dropped");
+    send(10, 1);
+    send_data(11, "0xdeadbeef");
+    send(12, 2);
+    REQUIRE(get_nonce() == 12);
+
+    // Runs 9 and 10. 11 fails and is dropped, and 12 waits for it again
+    send(9, 1);
+    REQUIRE(get() == 25);
+    REQUIRE(get_nonce("latest") == 11);
+    REQUIRE(get_nonce() == 12);
+
+    send(11, 5);
+    REQUIRE(get() == 32);
+    REQUIRE(get_nonce() == 13);
+  }
+
+  {
+    INFO("Rejected transactions do not create the sender's account");
+    TestAccount fresh(frontend, tables);
+    MessageCall mc;
+    mc.to = contract;
+    mc.data = eevm::to_bytes(abi_append(compiled.hashes["add(uint256)"], 1));
+    auto in = ethrpc::SendRawTransaction::make(sn++);
+    in.params.raw_transaction = fresh.sign_transaction(64, mc);
+    do_rpc(frontend, fresh.cert, in, false);
+
+    auto nonces = tables.get<evm4ccf::tables::Accounts::Nonces>(
+      "eth.account.nonce");
+    Store::Tx tx;
+    REQUIRE(!tx.get_view(*nonces)->get(fresh.address).has_value());
+  }
+}
@@ -0,0 +1,767 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#include "../src/app/account_proxy.h"
+#include "../src/app/arena.h"
+#include "../src/app/ethereum_state.h"
+#include "../src/app/receipt_logs.h"
+#include "ds/files.h"
+#include "ethereum_transaction.h"
+#include "hex_encoding.h"
+#include "node/encryptor.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <eEVM/opcode.h>
+#include <eEVM/processor.h>
+#include <eEVM/rlp.h>
+#include <eEVM/trace.h>
+#include <fstream>
+#include <map>
+#include <new>
+#include <nlohmann/json.hpp>
+#define PICOBENCH_IMPLEMENT
+#include <picobench/picobench.hpp>
+#include <random>
+
+using namespace ccf;
+using namespace evm4ccf;
+
+// Every allocation made by this process is counted, so that each benchmark can
+// report how many allocations an operation makes
+static std::atomic<size_t> allocations{0};
+
+void* operator new(size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (auto p = std::malloc(size))
+  {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  std::free(p);
+}
+
+// Runs f once per iteration. The number of allocations made by all iterations
+// is recorded as the result of the sample
+template <typename F>
+static void run(picobench::state& s, F&& f)
+{
+  const auto before = allocations.load(std::memory_order_relaxed);
+  for (auto _ : s)
+  {
+    f();
+  }
+  s.set_result(allocations.load(std::memory_order_relaxed) - before);
+}
+
+// Share of the arena blocks taken by each benchmark which came from this
+// thread's BlockPool rather than the heap. Only benchmarks whose states
+// outgrow an arena's inline buffer take any blocks
+static std::map<std::string, double> block_reuse_rate;
+
+// Like run, and also records the pool's reuse rate over the iterations
+template <typename F>
+static void run_pooled(picobench::state& s, const std::string& name, F&& f)
+{
+  const auto& pool = BlockPool::local();
+  const auto allocated = pool.get_allocated_blocks();
+  const auto reused = pool.get_reused_blocks();
+
+  run(s, std::forward<F>(f));
+
+  const auto n_reused = pool.get_reused_blocks() - reused;
+  const auto n_taken = n_reused + pool.get_allocated_blocks() - allocated;
+  if (n_taken != 0)
+  {
+    block_reuse_rate[name] = double(n_reused) / n_taken;
+  }
+}
+
+static volatile size_t sink;
+
+// Number of EVM instructions executed by one iteration of each benchmark which
+// runs bytecode, so that the report can give the time per instruction
+static std::map<std::string, size_t> instructions_per_op;
+
+static std::vector<uint8_t> random_bytes(size_t n)
+{
+  std::mt19937 rng(0);
+  std::vector<uint8_t> v(n);
+  for (auto& b : v)
+  {
+    b = (uint8_t)rng();
+  }
+  return v;
+}
+
+// ABI-encoded call: 4-byte selector followed by 32-byte arguments
+static std::vector<uint8_t> abi_call(
+  const std::string& selector, std::initializer_list<uint256_t> args)
+{
+  auto data = hex::to_bytes(selector);
+  for (const auto& arg : args)
+  {
+    const auto offset = data.size();
+    data.resize(offset + 32);
+    eevm::to_big_endian(arg, data.data() + offset);
+  }
+  return data;
+}
+
+struct Contract
+{
+  std::vector<uint8_t> deploy;
+  nlohmann::json hashes;
+};
+
+// Reads a contract compiled by tests/contracts/compile.sh, from the directory
+// given by CONTRACTS_DIR
+static Contract read_contract(const std::string& name)
+{
+  const auto contracts_dir = getenv("CONTRACTS_DIR");
+  if (contracts_dir == nullptr)
+  {
+    throw std::logic_error("CONTRACTS_DIR is not set");
+  }
+
+  const auto j = files::slurp_json(
+    std::string(contracts_dir) + "/" + name + "_combined.json");
+
+  // Each file holds a single contract, which may not be named after the file
+  const auto& contract = j["contracts"].begin().value();
+  return {hex::to_bytes(contract["bin"].get<std::string>()),
+          contract["hashes"]};
+}
+
+// A store holding the app's account and storage tables
+struct StateFixture
+{
+  Store store;
+  tables::Accounts accounts{
+    store.create<tables::Accounts::Balances>("eth.account.balance"),
+    store.create<tables::Accounts::Codes>("eth.account.code"),
+    store.create<tables::Accounts::Nonces>("eth.account.nonce")};
+  tables::Storage& storage = store.create<tables::Storage>("eth.storage");
+
+  const eevm::Address sender = 0x01234;
+
+  StateFixture()
+  {
+    store.set_encryptor(std::make_shared<NullTxEncryptor>());
+  }
+
+  EthereumState make_state(Store::Tx& tx)
+  {
+    return EthereumState(accounts.get_views(tx), tx.get_view(storage));
+  }
+
+  eevm::ExecResult execute(
+    EthereumState& es,
+    const eevm::Address& to,
+    const std::vector<uint8_t>& input,
+    eevm::Trace* trace = nullptr)
+  {
+    eevm::NullLogHandler ignore;
+    eevm::Transaction eth_tx(sender, ignore);
+    auto account_state = es.get(to);
+    eevm::Processor proc(es);
+    return proc.run(eth_tx, sender, account_state, input, 0, trace);
+  }
+
+  // Installs raw runtime code at a fresh address, and commits it
+  eevm::Address install(const std::vector<uint8_t>& code)
+  {
+    static eevm::Address next_address = 0xc0de0000;
+
+    Store::Tx tx;
+    auto es = make_state(tx);
+    const auto address = next_address++;
+    es.create(address, 0, code);
+    if (tx.commit() != kv::CommitSuccess::OK)
+    {
+      throw std::logic_error("Could not commit code");
+    }
+    return address;
+  }
+
+  // Runs a constructor, and commits the resulting contract
+  eevm::Address deploy(
+    const Contract& contract, std::initializer_list<uint256_t> args)
+  {
+    Store::Tx tx;
+    auto es = make_state(tx);
+
+    auto init = contract.deploy;
+    for (const auto& arg : args)
+    {
+      init.resize(init.size() + 32);
+      eevm::to_big_endian(arg, init.data() + init.size() - 32);
+    }
+
+    // As in run_in_evm, the constructor runs as the new account's code
+    const auto nonce = es.get(sender).acc.get_nonce();
+    const auto address = keccak::generate_address(sender, nonce);
+    es.create(address, 0, init);
+
+    auto result = execute(es, address, init);
+    if (result.er != eevm::ExitReason::returned)
+    {
+      throw std::logic_error("Deployment failed: " + result.exmsg);
+    }
+    es.get(address).acc.set_code(std::move(result.output));
+    es.get(sender).acc.increment_nonce();
+
+    if (tx.commit() != kv::CommitSuccess::OK)
+    {
+      throw std::logic_error("Could not commit deployment");
+    }
+    return address;
+  }
+
+  // Like eth_call, each iteration executes in a fresh transaction which is
+  // never committed, so every iteration sees the same state. One untimed
+  // execution is traced first, to count the instructions that each runs
+  void call(
+    picobench::state& s,
+    const std::string& name,
+    const eevm::Address& to,
+    const std::vector<uint8_t>& input)
+  {
+    {
+      Store::Tx tx;
+      auto es = make_state(tx);
+      eevm::Trace trace;
+      execute(es, to, input, &trace);
+      instructions_per_op[name] = trace.events.size();
+    }
+
+    run_pooled(s, name, [&]() {
+      Store::Tx tx;
+      auto es = make_state(tx);
+      const auto result = execute(es, to, input);
+      if (result.er == eevm::ExitReason::threw)
+      {
+        throw std::logic_error("Execution failed: " + result.exmsg);
+      }
+      sink = result.output.size();
+    });
+  }
+};
+
+static void evm_simplestore_add(picobench::state& s)
+{
+  StateFixture f;
+  const auto contract = read_contract("SimpleStore");
+  const auto address = f.deploy(contract, {42});
+  f.call(
+    s, __func__, address, abi_call(contract.hashes["add(uint256)"], {2}));
+}
+
+static void evm_erc20_transfer(picobench::state& s)
+{
+  StateFixture f;
+  const auto contract = read_contract("ERC20");
+  const auto address = f.deploy(contract, {1000000});
+  f.call(
+    s,
+    __func__,
+    address,
+    abi_call(contract.hashes["transfer(address,uint256)"], {0x5678, 100}));
+}
+
+static void evm_erc20_balance_of(picobench::state& s)
+{
+  StateFixture f;
+  const auto contract = read_contract("ERC20");
+  const auto address = f.deploy(contract, {1000000});
+  f.call(
+    s,
+    __func__,
+    address,
+    abi_call(contract.hashes["balanceOf(address)"], {f.sender}));
+}
+
+static void evm_ballot_give_right(picobench::state& s)
+{
+  StateFixture f;
+  const auto contract = read_contract("Ballot");
+  const auto address = f.deploy(contract, {8});
+  f.call(
+    s,
+    __func__,
+    address,
+    abi_call(contract.hashes["giveRightToVote(address)"], {0x5678}));
+}
+
+static void evm_events_emit(picobench::state& s)
+{
+  StateFixture f;
+  const auto contract = read_contract("Events");
+  const auto address = f.deploy(contract, {});
+  f.call(
+    s,
+    __func__,
+    address,
+    abi_call(
+      contract.hashes["emit_interesting(uint256,uint256,uint256)"],
+      {1, 2, 3}));
+}
+
+static void evm_ballot_winning_proposal(picobench::state& s)
+{
+  StateFixture f;
+  const auto contract = read_contract("Ballot");
+  const auto address = f.deploy(contract, {8});
+  f.call(
+    s,
+    __func__,
+    address,
+    abi_call(contract.hashes["winningProposal()"], {}));
+}
+
+// Bytecode which runs body n times, then tail. The loop counter is on top of
+// the stack at the start of each iteration, and body must leave the stack as
+// it found it
+static std::vector<uint8_t> loop(
+  uint16_t n,
+  const std::vector<uint8_t>& body,
+  const std::vector<uint8_t>& tail = {eevm::STOP})
+{
+  using namespace eevm;
+  constexpr uint8_t loop_start = 3;
+
+  std::vector<uint8_t> code = {PUSH2, (uint8_t)(n >> 8), (uint8_t)n, JUMPDEST};
+  code.insert(code.end(), body.begin(), body.end());
+  code.insert(
+    code.end(), {PUSH1, 1, SWAP1, SUB, DUP1, PUSH1, loop_start, JUMPI});
+  code.insert(code.end(), tail.begin(), tail.end());
+  return code;
+}
+
+// Loops of a few instructions each, to compare the per-instruction cost of
+// dispatch alone with that of arithmetic, memory, storage and hashing
+static constexpr uint16_t mix_iterations = 1000;
+
+static void mix(
+  picobench::state& s, const char* name, const std::vector<uint8_t>& body)
+{
+  StateFixture f;
+  const auto address = f.install(loop(mix_iterations, body));
+  f.call(s, name, address, {});
+}
+
+static void evm_mix_dispatch(picobench::state& s)
+{
+  mix(s, __func__, {});
+}
+
+static void evm_mix_arithmetic(picobench::state& s)
+{
+  using namespace eevm;
+  mix(s, __func__, {DUP1, PUSH1, 7, MUL, PUSH1, 3, ADD, POP});
+}
+
+static void evm_mix_memory(picobench::state& s)
+{
+  using namespace eevm;
+  mix(s, __func__, {DUP1, PUSH1, 0, MSTORE, PUSH1, 0, MLOAD, POP});
+}
+
+static void evm_mix_storage(picobench::state& s)
+{
+  using namespace eevm;
+  mix(s, __func__, {DUP1, PUSH1, 0, SSTORE, PUSH1, 0, SLOAD, POP});
+}
+
+static void evm_mix_keccak(picobench::state& s)
+{
+  using namespace eevm;
+  mix(s, __func__, {DUP1, PUSH1, 0, MSTORE, PUSH1, 32, PUSH1, 0, SHA3, POP});
+}
+
+// Like a call which builds large ABI-encoded return data, this fills memory a
+// word at a time from offset 0, growing it on every store, and returns it
+static void evm_large_return(picobench::state& s)
+{
+  using namespace eevm;
+  constexpr uint16_t words = mix_iterations;
+  constexpr uint16_t size = words * 32;
+
+  // Stores each counter value c at offset (words - c) * 32
+  const std::vector<uint8_t> body = {
+    DUP1, DUP1, PUSH2, words >> 8, words & 0xff, SUB, PUSH1, 32, MUL, MSTORE};
+  const std::vector<uint8_t> tail = {
+    PUSH2, size >> 8, size & 0xff, PUSH1, 0, RETURN};
+
+  StateFixture f;
+  const auto address = f.install(loop(words, body, tail));
+  f.call(s, __func__, address, {});
+}
+
+// Makes one CALL per iteration to a contract which returns a word, so that
+// the allocations reported per op show what each nested call frame costs
+static void evm_nested_calls(picobench::state& s)
+{
+  using namespace eevm;
+  StateFixture f;
+  const auto callee =
+    f.install({PUSH1, 42, PUSH1, 0, MSTORE, PUSH1, 32, PUSH1, 0, RETURN});
+
+  const auto c = static_cast<uint32_t>(callee);
+  const std::vector<uint8_t> body = {PUSH1,
+                                     32,
+                                     PUSH1,
+                                     0,
+                                     PUSH1,
+                                     0,
+                                     PUSH1,
+                                     0,
+                                     PUSH1,
+                                     0,
+                                     PUSH4,
+                                     (uint8_t)(c >> 24),
+                                     (uint8_t)(c >> 16),
+                                     (uint8_t)(c >> 8),
+                                     (uint8_t)c,
+                                     GAS,
+                                     CALL,
+                                     POP};
+
+  const auto address = f.install(loop(mix_iterations, body));
+  f.call(s, __func__, address, {});
+}
+
+// Storage slots touched by the AccountProxy benchmarks
+static constexpr size_t n_slots = 64;
+
+static void proxy_load(picobench::state& s)
+{
+  StateFixture f;
+  const eevm::Address address = 0x5678;
+  {
+    Store::Tx tx;
+    AccountProxy proxy(
+      address, f.accounts.get_views(tx), *tx.get_view(f.storage));
+    for (size_t i = 0; i < n_slots; ++i)
+    {
+      proxy.store(i, i + 1);
+    }
+    if (tx.commit() != kv::CommitSuccess::OK)
+    {
+      throw std::logic_error("Could not commit storage");
+    }
+  }
+
+  Store::Tx tx;
+  AccountProxy proxy(
+    address, f.accounts.get_views(tx), *tx.get_view(f.storage));
+  size_t i = 0;
+  run(s, [&]() { sink = (size_t)proxy.load(i++ % n_slots); });
+}
+
+static void proxy_store(picobench::state& s)
+{
+  StateFixture f;
+  Store::Tx tx;
+  AccountProxy proxy(0x5678, f.accounts.get_views(tx), *tx.get_view(f.storage));
+  size_t i = 0;
+  run(s, [&]() {
+    proxy.store(i % n_slots, i);
+    ++i;
+  });
+}
+
+// The state a single request builds: a fresh EthereumState which reads a few
+// accounts and some of their storage, like an ERC20 transfer. The proxies
+// and their caches come from the state's arena, so the allocations reported
+// are those made by the KV
+static void state_request(picobench::state& s)
+{
+  StateFixture f;
+  const std::vector<eevm::Address> addresses = {0x5678, 0x5679, 0x567a};
+  constexpr size_t slots_per_account = 8;
+
+  run_pooled(s, __func__, [&]() {
+    Store::Tx tx;
+    auto es = f.make_state(tx);
+    for (const auto& address : addresses)
+    {
+      auto account_state = es.get(address);
+      for (size_t i = 0; i < slots_per_account; ++i)
+      {
+        sink = (size_t)account_state.st.load(i);
+      }
+    }
+  });
+}
+
+// Logs shaped like those of an event with 3 indexed arguments, as the
+// Processor builds them, collected for a transaction's receipt
+static constexpr size_t logs_per_transaction = 16;
+
+template <typename Handler, typename Collect>
+static void collect_logs(picobench::state& s, Collect&& collect)
+{
+  const eevm::LogEntry log{0xc0de, random_bytes(32), {0x1234, 1, 2, 3}};
+
+  run(s, [&]() {
+    Handler handler;
+    for (size_t i = 0; i < logs_per_transaction; ++i)
+    {
+      auto entry = log;
+      handler.handle(std::move(entry));
+    }
+
+    TxResult tx_result;
+    collect(handler, tx_result);
+    sink = tx_result.logs.size();
+  });
+}
+
+static void logs_vector_handler(picobench::state& s)
+{
+  collect_logs<eevm::VectorLogHandler>(s, [](auto& handler, auto& result) {
+    result.logs = handler.logs;
+  });
+}
+
+static void logs_receipt_handler(picobench::state& s)
+{
+  collect_logs<ReceiptLogHandler>(s, [](auto& handler, auto& result) {
+    result.logs = std::move(handler.logs);
+  });
+}
+
+template <typename T>
+static void msgpack_roundtrip(picobench::state& s, const T& value)
+{
+  run(s, [&]() {
+    msgpack::sbuffer sb;
+    msgpack::pack(sb, value);
+    const auto oh = msgpack::unpack(sb.data(), sb.size());
+    sink = sizeof(oh.get().as<T>());
+  });
+}
+
+static void msgpack_uint256(picobench::state& s)
+{
+  const auto word = eevm::from_big_endian(random_bytes(32).data());
+  msgpack_roundtrip<uint256_t>(s, word);
+}
+
+static void msgpack_code(picobench::state& s)
+{
+  msgpack_roundtrip<eevm::Code>(s, random_bytes(1024));
+}
+
+static void msgpack_tx_result(picobench::state& s)
+{
+  // An ERC20 Transfer event
+  const eevm::LogEntry transfer{0x1234,
+                                random_bytes(32),
+                                {eevm::from_big_endian(random_bytes(32).data()),
+                                 0x1234,
+                                 0x5678}};
+  msgpack_roundtrip<TxResult>(s, TxResult{std::nullopt, {transfer}, 7, 0});
+}
+
+static void msgpack_block_header(picobench::state& s)
+{
+  BlockHeader header{};
+  header.number = 7;
+  header.block_hash = eevm::from_big_endian(random_bytes(32).data());
+  header.parent_hash = eevm::from_big_endian(random_bytes(32).data());
+  header.transactions = {header.block_hash};
+  msgpack_roundtrip<BlockHeader>(s, header);
+}
+
+// A signed ERC20 transfer
+static eevm::rlp::ByteString signed_transfer()
+{
+  static const auto encoded = [] {
+    tls::KeyPair_k1Bitcoin kp(MBEDTLS_ECP_DP_SECP256K1);
+    MessageCall mc;
+    mc.to = 0x5678;
+    mc.data = abi_call("0xa9059cbb", {0x9abc, 100});
+    return sign_transaction(kp, EthereumTransaction(3, mc)).encode();
+  }();
+  return encoded;
+}
+
+static void rlp_encode_transaction(picobench::state& s)
+{
+  MessageCall mc;
+  mc.to = 0x5678;
+  mc.data = abi_call("0xa9059cbb", {0x9abc, 100});
+  run(s, [&]() { sink = encode_unsigned_transaction(3, mc).size(); });
+}
+
+static void rlp_decode_transaction(picobench::state& s)
+{
+  const auto encoded = signed_transfer();
+  run(s, [&]() {
+    sink = EthereumTransactionWithSignature(encoded).data.size();
+  });
+}
+
+static void rlp_view_decode_transaction(picobench::state& s)
+{
+  const auto encoded = signed_transfer();
+  run(s, [&]() {
+    sink = SignedTransactionView({encoded.data(), encoded.size()}).data.n;
+  });
+}
+
+static void recover_sender(picobench::state& s)
+{
+  const auto encoded = signed_transfer();
+  const SignedTransactionView view({encoded.data(), encoded.size()});
+  run(s, [&]() { sink = (size_t)view.recover_sender(); });
+}
+
+// Maximum deployed contract size (EIP-170)
+static constexpr size_t max_code_size = 24 * 1024;
+
+static void hex_encode_code(picobench::state& s)
+{
+  const auto code = random_bytes(max_code_size);
+  run(s, [&]() { sink = hex::to_hex_string(code).size(); });
+}
+
+static void hex_decode_code(picobench::state& s)
+{
+  const auto code = hex::to_hex_string(random_bytes(max_code_size));
+  run(s, [&]() { sink = hex::to_bytes(code).size(); });
+}
+
+static void hex_encode_word(picobench::state& s)
+{
+  const auto word = eevm::from_big_endian(random_bytes(32).data());
+  run(s, [&]() { sink = hex::to_hex_string(word).size(); });
+}
+
+const std::vector<int> evm_iterations = {100, 1000};
+const std::vector<int> small_iterations = {1000, 10000};
+const std::vector<int> large_iterations = {10, 100};
+
+PICOBENCH_SUITE("run_in_evm");
+PICOBENCH(evm_simplestore_add).iterations(evm_iterations);
+PICOBENCH(evm_erc20_transfer).iterations(evm_iterations);
+PICOBENCH(evm_erc20_balance_of).iterations(evm_iterations);
+PICOBENCH(evm_ballot_give_right).iterations(evm_iterations);
+PICOBENCH(evm_ballot_winning_proposal).iterations(evm_iterations);
+PICOBENCH(evm_events_emit).iterations(evm_iterations);
+PICOBENCH(evm_large_return).iterations(large_iterations);
+PICOBENCH(evm_nested_calls).iterations(large_iterations);
+
+PICOBENCH_SUITE("opcode mix");
+PICOBENCH(evm_mix_dispatch).iterations(large_iterations);
+PICOBENCH(evm_mix_arithmetic).iterations(large_iterations);
+PICOBENCH(evm_mix_memory).iterations(large_iterations);
+PICOBENCH(evm_mix_storage).iterations(large_iterations);
+PICOBENCH(evm_mix_keccak).iterations(large_iterations);
+
+PICOBENCH_SUITE("AccountProxy");
+PICOBENCH(proxy_load).iterations(small_iterations);
+PICOBENCH(proxy_store).iterations(small_iterations);
+PICOBENCH(state_request).iterations(small_iterations);
+
+PICOBENCH_SUITE("Log collection");
+PICOBENCH(logs_vector_handler).iterations(small_iterations).baseline();
+PICOBENCH(logs_receipt_handler).iterations(small_iterations);
+
+PICOBENCH_SUITE("msgpack");
+PICOBENCH(msgpack_uint256).iterations(small_iterations);
+PICOBENCH(msgpack_code).iterations(small_iterations);
+PICOBENCH(msgpack_tx_result).iterations(small_iterations);
+PICOBENCH(msgpack_block_header).iterations(small_iterations);
+
+PICOBENCH_SUITE("RLP");
+PICOBENCH(rlp_encode_transaction).iterations(small_iterations);
+PICOBENCH(rlp_decode_transaction).iterations(small_iterations);
+PICOBENCH(rlp_view_decode_transaction).iterations(small_iterations);
+
+PICOBENCH_SUITE("Sender recovery");
+PICOBENCH(recover_sender).iterations(evm_iterations);
+
+PICOBENCH_SUITE("hex");
+PICOBENCH(hex_encode_code).iterations(large_iterations);
+PICOBENCH(hex_decode_code).iterations(large_iterations);
+PICOBENCH(hex_encode_word).iterations(small_iterations);
+
+// Results are reported as JSON, with one entry per benchmark and iteration
+// count. Each sample's result is the number of allocations it made. For
+// benchmarks which run bytecode, the time per executed instruction is also
+// reported, as is the share of arena blocks reused from the thread's pool
+static nlohmann::json to_json(const picobench::report& report)
+{
+  auto results = nlohmann::json::array();
+  for (const auto& suite : report.suites)
+  {
+    for (const auto& benchmark : suite.benchmarks)
+    {
+      for (const auto& d : benchmark.data)
+      {
+        const auto ns_per_op = double(d.total_time_ns) / d.dimension;
+        nlohmann::json result = {
+          {"suite", suite.name ? suite.name : ""},
+          {"name", benchmark.name},
+          {"iterations", d.dimension},
+          {"samples", d.samples},
+          {"ns_per_op", ns_per_op},
+          {"allocations_per_op", double(d.result) / d.dimension}};
+
+        const auto it = instructions_per_op.find(benchmark.name);
+        if (it != instructions_per_op.end() && it->second != 0)
+        {
+          result["instructions_per_op"] = it->second;
+          result["ns_per_instruction"] = ns_per_op / it->second;
+        }
+
+        const auto reuse_it = block_reuse_rate.find(benchmark.name);
+        if (reuse_it != block_reuse_rate.end())
+        {
+          result["block_reuse_rate"] = reuse_it->second;
+        }
+        results.push_back(result);
+      }
+    }
+  }
+  return {{"benchmarks", results}};
+}
+
+int main(int argc, char* argv[])
+{
+  picobench::runner r;
+  r.set_default_samples(5);
+  r.parse_cmd_line(argc, argv);
+  if (!r.should_run())
+  {
+    return r.error();
+  }
+
+  r.run_benchmarks();
+  const auto report = to_json(r.generate_report());
+
+  const auto filename = r.preferred_output_filename();
+  if (filename != nullptr)
+  {
+    std::ofstream out(filename);
+    out << report.dump(2) << std::endl;
+  }
+  else
+  {
+    std::cout << report.dump(2) << std::endl;
+  }
+
+  return r.error();
+}
@@ -0,0 +1,116 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#include "hex_encoding.h"
+
+#define PICOBENCH_IMPLEMENT_WITH_MAIN
+#include <picobench/picobench.hpp>
+#include <random>
+
+using namespace evm4ccf;
+
+// ERC20 transfer(address,uint256): 4-byte selector and two 32-byte arguments
+static const std::string erc20_calldata =
+  "0xa9059cbb000000000000000000000000d2e1d33d92935599575089ef13c52492f242f516"
+  "00000000000000000000000000000000000000000000000000000000000007d0";
+
+// Maximum deployed contract size (EIP-170)
+static constexpr size_t max_code_size = 24 * 1024;
+
+static const std::string& contract_code()
+{
+  static const std::string code = [] {
+    std::mt19937 rng(0);
+    std::vector<uint8_t> bytes(max_code_size);
+    for (auto& b : bytes)
+    {
+      b = (uint8_t)rng();
+    }
+    return eevm::to_hex_string(bytes);
+  }();
+  return code;
+}
+
+static const std::string address_str =
+  "0x4af4dce351a4747b5b33fcf66202612736401f95";
+
+static volatile size_t sink;
+
+template <typename F>
+static void run(picobench::state& s, F&& f)
+{
+  size_t total = 0;
+  for (auto _ : s)
+  {
+    total += f();
+  }
+  sink = total;
+}
+
+static void eevm_decode_calldata(picobench::state& s)
+{
+  run(s, [] { return eevm::to_bytes(erc20_calldata).size(); });
+}
+
+static void hex_decode_calldata(picobench::state& s)
+{
+  run(s, [] { return hex::to_bytes(erc20_calldata).size(); });
+}
+
+static void eevm_decode_code(picobench::state& s)
+{
+  const auto& code = contract_code();
+  run(s, [&] { return eevm::to_bytes(code).size(); });
+}
+
+static void hex_decode_code(picobench::state& s)
+{
+  const auto& code = contract_code();
+  run(s, [&] { return hex::to_bytes(code).size(); });
+}
+
+static void eevm_encode_code(picobench::state& s)
+{
+  const auto bytes = eevm::to_bytes(contract_code());
+  run(s, [&] { return eevm::to_hex_string(bytes).size(); });
+}
+
+static void hex_encode_code(picobench::state& s)
+{
+  const auto bytes = hex::to_bytes(contract_code());
+  run(s, [&] { return hex::to_hex_string(bytes).size(); });
+}
+
+static void eevm_uint256_roundtrip(picobench::state& s)
+{
+  run(s, [] {
+    const auto v = eevm::to_uint256(address_str);
+    return eevm::to_hex_string_fixed(v).size();
+  });
+}
+
+static void hex_uint256_roundtrip(picobench::state& s)
+{
+  run(s, [] {
+    const auto v = hex::to_uint256(address_str);
+    return hex::to_hex_string_fixed(v).size();
+  });
+}
+
+const std::vector<int> calldata_iterations = {1000, 10000};
+const std::vector<int> code_iterations = {10, 100};
+
+PICOBENCH_SUITE("erc20 calldata");
+PICOBENCH(eevm_decode_calldata).iterations(calldata_iterations).baseline();
+PICOBENCH(hex_decode_calldata).iterations(calldata_iterations);
+
+PICOBENCH_SUITE("24KB contract code decode");
+PICOBENCH(eevm_decode_code).iterations(code_iterations).baseline();
+PICOBENCH(hex_decode_code).iterations(code_iterations);
+
+PICOBENCH_SUITE("24KB contract code encode");
+PICOBENCH(eevm_encode_code).iterations(code_iterations).baseline();
+PICOBENCH(hex_encode_code).iterations(code_iterations);
+
+PICOBENCH_SUITE("uint256");
+PICOBENCH(eevm_uint256_roundtrip).iterations(calldata_iterations).baseline();
+PICOBENCH(hex_uint256_roundtrip).iterations(calldata_iterations);
@@ -0,0 +1,149 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#include "hex_encoding.h"
+
+#include <cctype>
+#include <doctest/doctest.h>
+#include <random>
+
+using namespace evm4ccf;
+using namespace intx;
+
+static std::vector<uint8_t> random_bytes(std::mt19937& rng, size_t n)
+{
+  std::vector<uint8_t> v(n);
+  for (auto& b : v)
+  {
+    b = (uint8_t)rng();
+  }
+  return v;
+}
+
+TEST_CASE("Byte strings" * doctest::test_suite("hex"))
+{
+  std::mt19937 rng(42);
+
+  // Cover empty input, scalar tails, and whole SSE/AVX2 blocks
+  for (size_t n = 0; n < 200; ++n)
+  {
+    INFO("Length " << n);
+    const auto bytes = random_bytes(rng, n);
+    const auto expected = eevm::to_hex_string(bytes);
+
+    REQUIRE(hex::to_hex_string(bytes) == expected);
+    REQUIRE(hex::to_bytes(expected) == bytes);
+    REQUIRE(hex::to_bytes(expected.substr(2)) == bytes);
+
+    // Upper-case digits are accepted
+    auto upper = expected;
+    std::transform(
+      upper.begin() + 2, upper.end(), upper.begin() + 2, [](char c) {
+        return (char)toupper(c);
+      });
+    REQUIRE(hex::to_bytes(upper) == bytes);
+
+    // Each implementation agrees with the scalar one
+    std::string scalar(2 * n, '\0');
+    hex::detail::encode_scalar(bytes.data(), n, scalar.data());
+    REQUIRE("0x" + scalar == expected);
+
+#ifdef EVM4CCF_X86
+    const auto& cpu = cpu_features();
+    if (cpu.sse41 && cpu.ssse3)
+    {
+      std::string encoded(2 * n, '\0');
+      hex::detail::encode_sse41(bytes.data(), n, encoded.data());
+      REQUIRE(encoded == scalar);
+
+      std::vector<uint8_t> decoded(n);
+      REQUIRE(hex::detail::decode_sse41(upper.data() + 2, n, decoded.data()));
+      REQUIRE(decoded == bytes);
+    }
+    if (cpu.avx2)
+    {
+      std::string encoded(2 * n, '\0');
+      hex::detail::encode_avx2(bytes.data(), n, encoded.data());
+      REQUIRE(encoded == scalar);
+
+      std::vector<uint8_t> decoded(n);
+      REQUIRE(hex::detail::decode_avx2(upper.data() + 2, n, decoded.data()));
+      REQUIRE(decoded == bytes);
+    }
+#endif
+  }
+
+  {
+    INFO("Odd-length strings have an implied leading 0");
+    REQUIRE(hex::to_bytes("0x55555") == eevm::to_bytes("0x55555"));
+    REQUIRE(hex::to_bytes("0x1") == std::vector<uint8_t>{0x1});
+  }
+
+  {
+    INFO("Invalid digits are rejected at any position");
+    const auto valid = hex::to_hex_string(random_bytes(rng, 100));
+    for (size_t i = 2; i < valid.size(); ++i)
+    {
+      auto invalid = valid;
+      invalid[i] = 'g';
+      REQUIRE_THROWS(hex::to_bytes(invalid));
+    }
+  }
+}
+
+TEST_CASE("Fixed-size arrays" * doctest::test_suite("hex"))
+{
+  std::array<uint8_t, 32> a;
+  for (size_t i = 0; i < a.size(); ++i)
+  {
+    a[i] = (uint8_t)(i * 7);
+  }
+
+  const auto s = hex::to_hex_string(a);
+  REQUIRE(s == eevm::to_hex_string(a));
+
+  std::array<uint8_t, 32> b;
+  hex::to_array(s, b);
+  REQUIRE(a == b);
+
+  REQUIRE_THROWS(hex::to_array(s.substr(0, s.size() - 2), b));
+}
+
+TEST_CASE("Numbers" * doctest::test_suite("hex"))
+{
+  std::mt19937 rng(42);
+
+  const std::vector<uint256_t> samples = {
+    0,
+    1,
+    0xff,
+    0x100,
+    0x4af4dcE351A4747B5b33Fcf66202612736401f95_u256,
+    ~uint256_t(0)};
+
+  for (const auto& v : samples)
+  {
+    REQUIRE(hex::to_hex_string(v) == eevm::to_hex_string(v));
+    REQUIRE(hex::to_hex_string_fixed(v) == eevm::to_hex_string_fixed(v));
+    REQUIRE(hex::to_uint256(eevm::to_hex_string(v)) == v);
+    REQUIRE(hex::to_uint256(eevm::to_hex_string_fixed(v)) == v);
+  }
+
+  for (size_t i = 0; i < 100; ++i)
+  {
+    const auto bytes = random_bytes(rng, 1 + rng() % 32);
+    const auto v = eevm::from_big_endian(bytes.data(), bytes.size());
+    const auto s = eevm::to_hex_string(v);
+    REQUIRE(hex::to_hex_string(v) == s);
+    REQUIRE(hex::to_uint256(s) == eevm::to_uint256(s));
+  }
+
+  const uint64_t n = 0x1234abcd;
+  REQUIRE(hex::to_hex_string(n) == eevm::to_hex_string(n));
+  REQUIRE(hex::to_hex_string(uint64_t(0)) == "0x0");
+
+  // Unprefixed strings are decimal, as in eevm::to_uint256
+  REQUIRE(hex::to_uint256("1234") == 1234);
+
+  REQUIRE_THROWS(hex::to_uint256("0x1" + std::string(64, '0')));
+  REQUIRE_THROWS(hex::to_uint256("0xabcz"));
+}
@@ -0,0 +1,169 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#include "keccak256.h"
+
+#include <doctest/doctest.h>
+#include <random>
+
+using namespace evm4ccf;
+
+static std::vector<uint8_t> random_bytes(std::mt19937& rng, size_t n)
+{
+  std::vector<uint8_t> v(n);
+  for (auto& b : v)
+  {
+    b = (uint8_t)rng();
+  }
+  return v;
+}
+
+TEST_CASE("Single inputs" * doctest::test_suite("keccak"))
+{
+  std::mt19937 rng(42);
+
+  REQUIRE(
+    eevm::to_hex_string(keccak::keccak_256(std::vector<uint8_t>{})) ==
+    "0xc5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470");
+
+  REQUIRE(
+    keccak::keccak_256(std::string("Transfer(address,address,uint256)")) ==
+    eevm::keccak_256("Transfer(address,address,uint256)"));
+
+  // Cover empty input, and lengths either side of each block boundary
+  for (size_t n = 0; n < 3 * keccak::rate + 2; ++n)
+  {
+    INFO("Length " << n);
+    const auto bytes = random_bytes(rng, n);
+    const auto expected = eevm::keccak_256(bytes);
+    REQUIRE(keccak::keccak_256(bytes) == expected);
+
+    // Incremental hashing gives the same result however the input is split
+    keccak::Hasher hasher;
+    for (size_t i = 0; i < n;)
+    {
+      const auto piece = std::min<size_t>(n - i, rng() % 50);
+      hasher.update(bytes.data() + i, piece);
+      i += piece;
+    }
+    REQUIRE(hasher.finalize() == expected);
+  }
+}
+
+TEST_CASE("Permutations" * doctest::test_suite("keccak"))
+{
+  std::mt19937_64 rng(42);
+
+  uint64_t state[keccak::state_lanes];
+  for (auto& lane : state)
+  {
+    lane = rng();
+  }
+
+  uint64_t expected[keccak::state_lanes];
+  std::copy(std::begin(state), std::end(state), std::begin(expected));
+  keccak::detail::keccak_f_scalar(expected);
+
+#ifdef EVM4CCF_X86
+  const auto& cpu = cpu_features();
+  if (cpu.bmi1 && cpu.bmi2)
+  {
+    uint64_t actual[keccak::state_lanes];
+    std::copy(std::begin(state), std::end(state), std::begin(actual));
+    keccak::detail::keccak_f_bmi2(actual);
+    REQUIRE(std::equal(std::begin(actual), std::end(actual), expected));
+  }
+#endif
+}
+
+TEST_CASE("Multiple inputs" * doctest::test_suite("keccak"))
+{
+  std::mt19937 rng(42);
+
+  for (size_t i = 0; i < 100; ++i)
+  {
+    // Lengths differ, so that some inputs finish several blocks before others
+    std::vector<uint8_t> inputs[4];
+    CBuffer buffers[4];
+    for (size_t k = 0; k < 4; ++k)
+    {
+      inputs[k] = random_bytes(rng, rng() % (4 * keccak::rate));
+      buffers[k] = {inputs[k].data(), inputs[k].size()};
+    }
+
+    eevm::KeccakHash hashes[4];
+    uint8_t* const out[4] = {
+      hashes[0].data(), hashes[1].data(), hashes[2].data(), hashes[3].data()};
+
+    keccak::keccak_256_x4(buffers, out);
+    for (size_t k = 0; k < 4; ++k)
+    {
+      REQUIRE(hashes[k] == eevm::keccak_256(inputs[k]));
+    }
+
+    keccak::detail::keccak_256_x4_scalar(buffers, out);
+    for (size_t k = 0; k < 4; ++k)
+    {
+      REQUIRE(hashes[k] == eevm::keccak_256(inputs[k]));
+    }
+  }
+
+  {
+    INFO("Batches which are not a multiple of 4 are completed one at a time");
+    std::vector<std::vector<uint8_t>> inputs;
+    std::vector<CBuffer> buffers;
+    for (size_t i = 0; i < 11; ++i)
+    {
+      inputs.push_back(random_bytes(rng, 64));
+    }
+    for (const auto& input : inputs)
+    {
+      buffers.push_back({input.data(), input.size()});
+    }
+
+    const auto hashes = keccak::keccak_256_many(buffers);
+    REQUIRE(hashes.size() == inputs.size());
+    for (size_t i = 0; i < inputs.size(); ++i)
+    {
+      REQUIRE(hashes[i] == eevm::keccak_256(inputs[i]));
+    }
+  }
+}
+
+TEST_CASE("Addresses" * doctest::test_suite("keccak"))
+{
+  std::mt19937 rng(42);
+
+  {
+    INFO("Contract addresses match eEVM's");
+    for (size_t i = 0; i < 100; ++i)
+    {
+      const auto sender_bytes = random_bytes(rng, 20);
+      const auto sender = eevm::from_big_endian(sender_bytes.data(), 20u);
+      const uint64_t nonce = i < 50 ? i : rng();
+      REQUIRE(
+        keccak::generate_address(sender, nonce) ==
+        eevm::generate_address(sender, nonce));
+    }
+  }
+
+  {
+    INFO("Checksums match the EIP-55 examples");
+    for (const std::string expected : {
+           "0x5aAeb6053F3E94C9b9A09f33669435E7Ef1BeAed",
+           "0xfB6916095ca1df60bB79Ce92cE3Ea74c37c5d359",
+           "0xdbF03B407c01E7cD3CBea99509d93f8DDDC8C6FB",
+           "0xD1220A0cf47c7B9Be7A2E6BA89F429762e7b9aDb",
+         })
+    {
+      const auto address = hex::to_uint256(expected);
+      REQUIRE(keccak::to_checksum_address(address) == expected);
+    }
+  }
+
+  {
+    INFO("Short addresses are zero-padded to 40 digits");
+    const auto checksummed = keccak::to_checksum_address(0x1234);
+    REQUIRE(checksummed.size() == 42);
+    REQUIRE(hex::to_uint256(checksummed) == 0x1234);
+  }
+}
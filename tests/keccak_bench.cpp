@@ -0,0 +1,129 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#include "keccak256.h"
+
+#define PICOBENCH_IMPLEMENT_WITH_MAIN
+#include <picobench/picobench.hpp>
+#include <random>
+
+using namespace evm4ccf;
+
+static std::vector<uint8_t> random_bytes(size_t n)
+{
+  std::mt19937 rng(0);
+  std::vector<uint8_t> v(n);
+  for (auto& b : v)
+  {
+    b = (uint8_t)rng();
+  }
+  return v;
+}
+
+// Solidity mapping slots hash a 32-byte key followed by a 32-byte slot index
+static constexpr size_t mapping_key_size = 64;
+
+// A typical signed ERC20 transfer
+static constexpr size_t transaction_size = 170;
+
+// Maximum deployed contract size (EIP-170)
+static constexpr size_t max_code_size = 24 * 1024;
+
+static volatile uint8_t sink;
+
+template <size_t N>
+static void eevm_single(picobench::state& s)
+{
+  auto input = random_bytes(N);
+  uint8_t total = 0;
+  for (auto _ : s)
+  {
+    input[0] = (uint8_t)_;
+    total += eevm::keccak_256(input)[0];
+  }
+  sink = total;
+}
+
+template <size_t N>
+static void keccak_single(picobench::state& s)
+{
+  auto input = random_bytes(N);
+  uint8_t total = 0;
+  for (auto _ : s)
+  {
+    input[0] = (uint8_t)_;
+    total += keccak::keccak_256(input)[0];
+  }
+  sink = total;
+}
+
+// Each iteration hashes 4 inputs, so is compared against 4 single hashes
+template <size_t N>
+static void eevm_batch(picobench::state& s)
+{
+  auto input = random_bytes(N);
+  uint8_t total = 0;
+  for (auto _ : s)
+  {
+    for (size_t k = 0; k < 4; ++k)
+    {
+      input[0] = (uint8_t)(_ + k);
+      total += eevm::keccak_256(input)[0];
+    }
+  }
+  sink = total;
+}
+
+template <size_t N>
+static void keccak_x4(picobench::state& s)
+{
+  std::vector<uint8_t> inputs[4];
+  CBuffer buffers[4];
+  for (size_t k = 0; k < 4; ++k)
+  {
+    inputs[k] = random_bytes(N);
+    buffers[k] = {inputs[k].data(), inputs[k].size()};
+  }
+
+  eevm::KeccakHash hashes[4];
+  uint8_t* const out[4] = {
+    hashes[0].data(), hashes[1].data(), hashes[2].data(), hashes[3].data()};
+
+  uint8_t total = 0;
+  for (auto _ : s)
+  {
+    for (size_t k = 0; k < 4; ++k)
+    {
+      inputs[k][0] = (uint8_t)(_ + k);
+    }
+    keccak::keccak_256_x4(buffers, out);
+    total += hashes[0][0];
+  }
+  sink = total;
+}
+
+const std::vector<int> small_iterations = {1000, 10000};
+const std::vector<int> large_iterations = {10, 100};
+
+PICOBENCH_SUITE("mapping key");
+static auto eevm_key = eevm_single<mapping_key_size>;
+PICOBENCH(eevm_key).iterations(small_iterations).baseline();
+static auto keccak_key = keccak_single<mapping_key_size>;
+PICOBENCH(keccak_key).iterations(small_iterations);
+
+PICOBENCH_SUITE("4 mapping keys");
+static auto eevm_keys = eevm_batch<mapping_key_size>;
+PICOBENCH(eevm_keys).iterations(small_iterations).baseline();
+static auto keccak_keys = keccak_x4<mapping_key_size>;
+PICOBENCH(keccak_keys).iterations(small_iterations);
+
+PICOBENCH_SUITE("4 transactions");
+static auto eevm_txs = eevm_batch<transaction_size>;
+PICOBENCH(eevm_txs).iterations(small_iterations).baseline();
+static auto keccak_txs = keccak_x4<transaction_size>;
+PICOBENCH(keccak_txs).iterations(small_iterations);
+
+PICOBENCH_SUITE("24KB contract code");
+static auto eevm_code = eevm_single<max_code_size>;
+PICOBENCH(eevm_code).iterations(large_iterations).baseline();
+static auto keccak_code = keccak_single<max_code_size>;
+PICOBENCH(keccak_code).iterations(large_iterations);
@@ -118,7 +118,9 @@ evm4ccf::TxResult make_rand<evm4ccf::TxResult>()
   for (size_t i = 0; i < logs.size(); ++i)
     logs[i] = make_rand<eevm::LogEntry>();
   return evm4ccf::TxResult{make_rand<decltype(eevm::LogEntry::address)>(),
-                           logs};
+                           logs,
+                           make_rand<uint64_t>(),
+                           make_rand<uint64_t>()};
 }
 
 template <>
@@ -131,7 +133,9 @@ evm4ccf::BlockHeader make_rand<evm4ccf::BlockHeader>()
     make_rand<decltype(evm4ccf::BlockHeader::gas_used)>(),
     make_rand<decltype(evm4ccf::BlockHeader::timestamp)>(),
     make_rand<decltype(evm4ccf::BlockHeader::miner)>(),
-    make_rand<decltype(evm4ccf::BlockHeader::block_hash)>()};
+    make_rand<decltype(evm4ccf::BlockHeader::block_hash)>(),
+    make_rand<decltype(evm4ccf::BlockHeader::parent_hash)>(),
+    {make_rand<evm4ccf::TxHash>(), make_rand<evm4ccf::TxHash>()}};
 }
 
 using namespace intx;
@@ -217,6 +221,202 @@ TEST_CASE("evm4ccf::BlockHeader" * doctest::test_suite("conversions"))
   require_roundtrip(make_rand<evm4ccf::BlockHeader>());
 }
 
+TEST_CASE("evm4ccf::HistoryDelta" * doctest::test_suite("conversions"))
+{
+  const evm4ccf::HistoryDelta a{};
+  const evm4ccf::HistoryDelta b{{address}, {}, {address, 0x1}, {}};
+  const evm4ccf::HistoryDelta c{
+    {0x1}, {0x2}, {0x3}, {{address, 0x4}, {address, make_rand<uint256_t>()}}};
+
+  require_roundtrip(a, b, c);
+}
+
+TEST_CASE("evm4ccf::TracingSettings" * doctest::test_suite("conversions"))
+{
+  const evm4ccf::TracingSettings a{};
+  const evm4ccf::TracingSettings b{1, 2, 8, {address}};
+  const evm4ccf::TracingSettings c{
+    make_rand<uint64_t>(), 0, 64, {0x1, make_rand<uint256_t>()}};
+
+  require_roundtrip(a, b, c);
+}
+
+TEST_CASE("evm4ccf::QueuedTransaction" * doctest::test_suite("conversions"))
+{
+  const evm4ccf::QueuedTransaction a{};
+  const evm4ccf::QueuedTransaction b{{0x01, 0xf8, 0x7c}, true};
+  const evm4ccf::QueuedTransaction c{rand_bytes(170), false};
+
+  require_roundtrip(a, b, c);
+}
+
+TEST_CASE("Receipt logs" * doctest::test_suite("conversions"))
+{
+  const std::vector<eevm::LogEntry> logs = {
+    {0xc0de, {0x1, 0x2, 0x3}, {0xa, 0xb, 0xc, 0xd}},
+    {0xc0de, {}, {}},
+    {address,
+     make_rand<decltype(eevm::LogEntry::data)>(),
+     {make_rand<uint256_t>()}}};
+
+  ReceiptLogHandler handler;
+  for (auto log : logs)
+  {
+    handler.handle(std::move(log));
+  }
+  const auto& flat = handler.logs;
+  REQUIRE(flat.size() == logs.size());
+
+  {
+    INFO("Topics are held inline, and data is a range of one buffer");
+    size_t offset = 0;
+    for (size_t i = 0; i < logs.size(); ++i)
+    {
+      const auto& entry = flat[i];
+      REQUIRE(entry.address == logs[i].address);
+      REQUIRE(entry.topic_count == logs[i].topics.size());
+      for (size_t t = 0; t < entry.topic_count; ++t)
+      {
+        REQUIRE(entry.topics[t] == logs[i].topics[t]);
+      }
+
+      REQUIRE(entry.data_offset == offset);
+      REQUIRE(entry.data_size == logs[i].data.size());
+      const auto data = flat.data_of(entry);
+      REQUIRE(
+        std::vector<uint8_t>(data, data + entry.data_size) == logs[i].data);
+      offset += entry.data_size;
+    }
+  }
+
+  {
+    INFO("Logs read back as eEVM's entries");
+    REQUIRE(flat.to_log_entries() == logs);
+    REQUIRE(flat == ReceiptLogs(logs));
+
+    const TxResult result{std::nullopt, flat, 1, 0};
+    require_roundtrip(result);
+    REQUIRE(nlohmann::json(result).get<TxResult>().logs == flat);
+  }
+
+  {
+    INFO("A log may not have more than 4 topics");
+    ReceiptLogs too_many;
+    REQUIRE_THROWS_AS(
+      too_many.add({0xc0de, {}, {1, 2, 3, 4, 5}}), std::logic_error);
+    REQUIRE(too_many.empty());
+  }
+}
+
+#ifndef USE_NLJSON_KV_SERIALISER
+TEST_CASE("Legacy formats" * doctest::test_suite("conversions"))
+{
+  // Values written before blocks were produced omit the trailing fields
+  msgpack::sbuffer sb;
+  msgpack::packer<msgpack::sbuffer> packer(sb);
+
+  const std::vector<eevm::LogEntry> logs = {make_rand<eevm::LogEntry>()};
+  packer.pack_array(2);
+  packer.pack(address);
+  packer.pack(logs);
+
+  packer.pack_array(7);
+  packer.pack(uint64_t(0x55));
+  packer.pack(uint64_t(0x44));
+  packer.pack(uint64_t(0x33));
+  packer.pack(uint64_t(0x22));
+  packer.pack(uint64_t(0x11));
+  packer.pack(address);
+  packer.pack(uint256_t(0xabcd));
+
+  size_t offset = 0;
+  const auto result =
+    msgpack::unpack(sb.data(), sb.size(), offset).get().as<TxResult>();
+  REQUIRE(result == TxResult{address, logs, 0, 0});
+
+  const auto header =
+    msgpack::unpack(sb.data(), sb.size(), offset).get().as<BlockHeader>();
+  REQUIRE(header == BlockHeader{0x55, 0x44, 0x33, 0x22, 0x11, address, 0xabcd});
+
+  // Results written before the compact encoding are arrays of their fields
+  msgpack::sbuffer sb4;
+  msgpack::packer<msgpack::sbuffer> packer4(sb4);
+  packer4.pack_array(4);
+  packer4.pack(address);
+  packer4.pack(logs);
+  packer4.pack(uint64_t(7));
+  packer4.pack(uint64_t(2));
+
+  const auto full =
+    msgpack::unpack(sb4.data(), sb4.size()).get().as<TxResult>();
+  REQUIRE(full == TxResult{address, logs, 7, 2});
+}
+
+TEST_CASE("Compact receipts" * doctest::test_suite("conversions"))
+{
+  const auto transfer_signature = receipts::well_known_topics()[0];
+  REQUIRE(
+    transfer_signature ==
+    eevm::from_big_endian(
+      keccak::keccak_256(std::string("Transfer(address,address,uint256)"))
+        .data()));
+
+  // A batch of ERC20 transfers from one contract to one recipient
+  const eevm::Address token = 0xc0de;
+  const uint256_t from = 0x1234;
+  const uint256_t to = 0x5678;
+  std::vector<eevm::LogEntry> logs;
+  for (size_t i = 0; i < 4; ++i)
+  {
+    eevm::log::Data amount(32, 0);
+    amount.back() = i;
+    logs.push_back({token, amount, {transfer_signature, from, to}});
+  }
+  const TxResult result{std::nullopt, logs, 1000, 3};
+
+  {
+    INFO("Repeated addresses and topics are stored once");
+    const auto encoded = receipts::encode(result);
+    REQUIRE(receipts::decode(encoded) == result);
+
+    // For each log: an address reference, a topic count, 3 topic
+    // references, a data length and 32 bytes of data
+    const size_t per_log = 1 + 1 + 3 + 1 + 32;
+    REQUIRE(encoded.size() <= 20 + logs.size() * per_log);
+  }
+
+  {
+    INFO("Empty fields are omitted");
+    REQUIRE(receipts::encode(TxResult{}).size() == 1);
+    REQUIRE(receipts::decode(receipts::encode(TxResult{})) == TxResult{});
+
+    const TxResult zero_address{eevm::Address(0), {}, 0, 0};
+    REQUIRE(receipts::decode(receipts::encode(zero_address)) == zero_address);
+  }
+
+  {
+    INFO("Truncated receipts are rejected");
+    auto encoded = receipts::encode(result);
+    encoded.pop_back();
+    REQUIRE_THROWS(receipts::decode(encoded));
+  }
+
+  {
+    INFO("Counts are checked against the remaining bytes before allocating");
+    // has_logs, then a dictionary of 2^40 words with nothing after it
+    const std::vector<uint8_t> huge_dictionary = {
+      receipts::has_logs, 0x80, 0x80, 0x80, 0x80, 0x80, 0x20};
+    REQUIRE_THROWS_WITH(
+      receipts::decode(huge_dictionary), "Receipt is truncated");
+
+    // An empty dictionary, then 2^40 logs
+    const std::vector<uint8_t> huge_logs = {
+      receipts::has_logs, 0x00, 0x80, 0x80, 0x80, 0x80, 0x80, 0x20};
+    REQUIRE_THROWS_WITH(receipts::decode(huge_logs), "Receipt is truncated");
+  }
+}
+#endif
+
 TEST_CASE("mixed random" * doctest::test_suite("conversions"))
 {
   require_roundtrip(
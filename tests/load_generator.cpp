@@ -0,0 +1,344 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#include "shared.h"
+
+#include <algorithm>
+#include <chrono>
+#include <doctest/doctest.h>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <thread>
+
+using namespace ccf;
+using namespace evm4ccf;
+
+// Drives the frontend directly from many threads, each sending a mix of
+// requests on behalf of its own signed senders. The load is configured by
+// environment variables:
+//  LOAD_THREADS     - number of client threads (default 4)
+//  LOAD_OPERATIONS  - requests sent by each thread (default 250)
+//  LOAD_SENDERS     - distinct signing accounts, shared out between threads
+//                     (default 32)
+//  LOAD_MIX         - relative weights of each operation, for example
+//                     "transfer=60,call=25,receipt=10,deploy=5" (the default)
+//  LOAD_REPORT      - if set, the JSON report is written to this file rather
+//                     than stdout
+//
+// Every write request updates the pending block, so concurrent writes
+// conflict in the KV and are retried by the frontend. The write latencies
+// therefore include the cost of that contention.
+
+namespace
+{
+  using Clock = std::chrono::steady_clock;
+
+  enum class Operation
+  {
+    Transfer,
+    Deploy,
+    Call,
+    Receipt
+  };
+
+  const std::vector<std::pair<std::string, Operation>> operation_names = {
+    {"transfer", Operation::Transfer},
+    {"deploy", Operation::Deploy},
+    {"call", Operation::Call},
+    {"receipt", Operation::Receipt}};
+
+  size_t env_or(const char* name, size_t default_value)
+  {
+    const auto value = getenv(name);
+    return value == nullptr ? default_value : std::stoul(value);
+  }
+
+  // Parses "name=weight,..." into a weight for each operation
+  std::map<Operation, size_t> parse_mix(const std::string& s)
+  {
+    std::map<Operation, size_t> mix;
+    std::stringstream ss(s);
+    std::string entry;
+    while (std::getline(ss, entry, ','))
+    {
+      const auto eq = entry.find('=');
+      const auto name = entry.substr(0, eq);
+      const auto it = std::find_if(
+        operation_names.begin(),
+        operation_names.end(),
+        [&](const auto& op) { return op.first == name; });
+      if (eq == std::string::npos || it == operation_names.end())
+      {
+        throw std::invalid_argument(
+          fmt::format("Invalid LOAD_MIX entry: '{}'", entry));
+      }
+      mix[it->second] = std::stoul(entry.substr(eq + 1));
+    }
+    return mix;
+  }
+
+  // Like do_rpc, but returns nullopt on error rather than asserting, so that
+  // it can be called from client threads
+  std::optional<nlohmann::json> send(
+    Ethereum& frontend, const std::vector<uint8_t>& cert, nlohmann::json rpc)
+  {
+    const enclave::SessionContext session(0, cert);
+    const auto packed = pack(rpc);
+    const auto rpc_ctx = enclave::make_rpc_context(session, packed);
+    const auto r = frontend->process(rpc_ctx);
+    if (!r.has_value())
+    {
+      return std::nullopt;
+    }
+
+    auto j = unpack(r.value());
+    if (j.find(std::string(jsonrpc::ERR)) != j.end())
+    {
+      return std::nullopt;
+    }
+    return j;
+  }
+
+  struct Sender
+  {
+    std::unique_ptr<TestAccount> account;
+    size_t nonce = 0;
+  };
+
+  struct Samples
+  {
+    std::vector<uint64_t> latencies_ns;
+    size_t errors = 0;
+  };
+
+  nlohmann::json summarise(Samples& samples)
+  {
+    auto& ns = samples.latencies_ns;
+    std::sort(ns.begin(), ns.end());
+
+    const auto percentile_us = [&](double p) {
+      if (ns.empty())
+      {
+        return 0.0;
+      }
+      const auto i = std::min(ns.size() - 1, (size_t)(p * ns.size()));
+      return ns[i] / 1000.0;
+    };
+
+    // Buckets double in width, starting from latencies under 1us
+    auto histogram = nlohmann::json::array();
+    uint64_t bound_us = 1;
+    size_t counted = 0;
+    while (counted < ns.size())
+    {
+      const auto end =
+        std::lower_bound(ns.begin() + counted, ns.end(), bound_us * 1000);
+      const size_t n = end - (ns.begin() + counted);
+      histogram.push_back({{"le_us", bound_us}, {"count", n}});
+      counted += n;
+      bound_us *= 2;
+    }
+
+    return {{"count", ns.size()},
+            {"errors", samples.errors},
+            {"p50_us", percentile_us(0.5)},
+            {"p99_us", percentile_us(0.99)},
+            {"p999_us", percentile_us(0.999)},
+            {"histogram", histogram}};
+  }
+} // namespace
+
+TEST_CASE("LoadGenerator" * doctest::test_suite("load"))
+{
+  const auto n_threads = std::max<size_t>(env_or("LOAD_THREADS", 4), 1);
+  const auto n_operations = env_or("LOAD_OPERATIONS", 250);
+  const auto n_senders =
+    std::max(env_or("LOAD_SENDERS", 32), n_threads) / n_threads * n_threads;
+  const auto mix_env = getenv("LOAD_MIX");
+  const auto mix = parse_mix(
+    mix_env == nullptr ? "transfer=60,call=25,receipt=10,deploy=5" : mix_env);
+
+  std::vector<Operation> operations;
+  std::vector<size_t> weights;
+  for (const auto& [op, weight] : mix)
+  {
+    operations.push_back(op);
+    weights.push_back(weight);
+  }
+
+  NetworkTables nwt;
+  StubNotifier stubn;
+  Store& tables = *nwt.tables;
+  setup_tables(tables);
+  Ethereum frontend = ccfapp::get_rpc_handler(nwt, stubn);
+
+  const auto erc20 = read_bytecode("ERC20Token", "ERC20");
+  const auto simple_store = read_bytecode("SimpleStore");
+  const auto simple_store_deploy =
+    hex::to_bytes(abi_append(simple_store.deploy, 42));
+
+  // Looked up before the client threads start, as the non-const
+  // nlohmann::json::operator[] may insert, and is not safe to call
+  // concurrently
+  const std::string transfer = erc20.hashes["transfer(address,uint256)"];
+  const std::string balance_of = erc20.hashes["balanceOf(address)"];
+
+  // Setup is sequential. The owner deploys the token and funds every sender
+  constexpr size_t funding = 1'000'000;
+  TestAccount owner(frontend, tables);
+  const auto token = owner.deploy_contract(
+    abi_append(erc20.deploy, funding * (n_senders + 1)));
+
+  std::vector<Sender> senders(n_senders);
+  for (auto& sender : senders)
+  {
+    sender.account = std::make_unique<TestAccount>(frontend, tables);
+    owner.contract_transact(
+      token, abi_append(transfer, sender.account->address, funding));
+  }
+
+  std::vector<std::map<Operation, Samples>> results(n_threads);
+
+  auto client = [&](size_t thread_index) {
+    std::mt19937 rng(thread_index);
+    std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+    std::uniform_int_distribution<size_t> pick_recipient(0, n_senders - 1);
+
+    const auto senders_per_thread = n_senders / n_threads;
+    const auto first = thread_index * senders_per_thread;
+    std::vector<TxHash> sent;
+    jsonrpc::SeqNo sn = 0;
+
+    for (size_t i = 0; i < n_operations; ++i)
+    {
+      auto& sender = senders[first + i % senders_per_thread];
+      const auto op = operations[pick(rng)];
+
+      nlohmann::json rpc;
+      switch (op)
+      {
+        case Operation::Transfer:
+        {
+          MessageCall mc;
+          mc.to = token;
+          mc.data = hex::to_bytes(abi_append(
+            transfer, senders[pick_recipient(rng)].account->address, 1));
+          auto in = ethrpc::SendRawTransaction::make(sn++);
+          in.params.raw_transaction =
+            sender.account->sign_transaction(sender.nonce, mc);
+          rpc = in;
+          break;
+        }
+        case Operation::Deploy:
+        {
+          MessageCall mc;
+          mc.data = simple_store_deploy;
+          auto in = ethrpc::SendRawTransaction::make(sn++);
+          in.params.raw_transaction =
+            sender.account->sign_transaction(sender.nonce, mc);
+          rpc = in;
+          break;
+        }
+        case Operation::Call:
+        {
+          auto in = ethrpc::Call::make(sn++);
+          in.params.call_data.from = sender.account->address;
+          in.params.call_data.to = token;
+          in.params.call_data.data =
+            abi_append(balance_of, sender.account->address);
+          rpc = in;
+          break;
+        }
+        case Operation::Receipt:
+        {
+          auto in = ethrpc::GetTransactionReceipt::make(sn++);
+          in.params.tx_hash = sent.empty() ? 0 : sent[rng() % sent.size()];
+          rpc = in;
+          break;
+        }
+      }
+
+      const auto start = Clock::now();
+      const auto response = send(frontend, sender.account->cert, rpc);
+      const auto elapsed = Clock::now() - start;
+
+      auto& samples = results[thread_index][op];
+      samples.latencies_ns.push_back(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+      if (!response.has_value())
+      {
+        ++samples.errors;
+      }
+      else if (op == Operation::Transfer || op == Operation::Deploy)
+      {
+        // Only a transaction which was executed uses up its nonce
+        ++sender.nonce;
+        sent.push_back(
+          eevm::to_uint256(response->at("result").get<std::string>()));
+      }
+    }
+  };
+
+  const auto start = Clock::now();
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < n_threads; ++i)
+  {
+    threads.emplace_back(client, i);
+  }
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+  const auto elapsed_s =
+    std::chrono::duration<double>(Clock::now() - start).count();
+
+  std::map<Operation, Samples> merged;
+  for (auto& thread_results : results)
+  {
+    for (auto& [op, samples] : thread_results)
+    {
+      auto& m = merged[op];
+      m.latencies_ns.insert(
+        m.latencies_ns.end(),
+        samples.latencies_ns.begin(),
+        samples.latencies_ns.end());
+      m.errors += samples.errors;
+    }
+  }
+
+  size_t total = 0;
+  size_t errors = 0;
+  nlohmann::json by_operation = nlohmann::json::object();
+  for (const auto& [name, op] : operation_names)
+  {
+    auto it = merged.find(op);
+    if (it != merged.end())
+    {
+      total += it->second.latencies_ns.size();
+      errors += it->second.errors;
+      by_operation[name] = summarise(it->second);
+    }
+  }
+
+  const nlohmann::json report = {{"threads", n_threads},
+                                 {"senders", n_senders},
+                                 {"requests", total},
+                                 {"errors", errors},
+                                 {"duration_s", elapsed_s},
+                                 {"throughput_per_s", total / elapsed_s},
+                                 {"operations", by_operation}};
+
+  const auto report_path = getenv("LOAD_REPORT");
+  if (report_path != nullptr)
+  {
+    std::ofstream(report_path) << report.dump(2) << std::endl;
+  }
+  else
+  {
+    std::cout << report.dump(2) << std::endl;
+  }
+
+  REQUIRE(total == n_threads * n_operations);
+  REQUIRE(errors == 0);
+}
@@ -0,0 +1,110 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#include "shared.h"
+
+#include <doctest/doctest.h>
+
+using namespace ccf;
+using namespace evm4ccf;
+
+TEST_CASE("Metrics0" * doctest::test_suite("metrics"))
+{
+  NetworkTables nwt;
+  StubNotifier stubn;
+  Store& tables = *nwt.tables;
+  auto cert = setup_tables(tables);
+  Ethereum frontend = ccfapp::get_rpc_handler(nwt, stubn);
+  jsonrpc::SeqNo sn = 0;
+  add_operator(tables, cert, 0xa);
+
+  auto get_metrics = [&]() {
+    auto in = apprpc::GetMetrics::make(sn++);
+    const apprpc::GetMetrics::Out out = do_rpc(frontend, cert, in);
+    return out.result;
+  };
+
+  {
+    INFO("Every method is listed before it is called, with no phases");
+    const auto metrics = get_metrics();
+    REQUIRE(metrics.contains(ethrpc::Call::name));
+    REQUIRE(metrics.contains(ethrpc::SendRawTransaction::name));
+    REQUIRE(metrics[ethrpc::Call::name].empty());
+  }
+
+  const auto compiled = read_bytecode("SimpleStore");
+  TestAccount owner(frontend, tables);
+  const auto contract = owner.deploy_contract(abi_append(compiled.deploy, 1));
+
+  constexpr size_t n_transactions = 3;
+  for (size_t i = 0; i < n_transactions; ++i)
+  {
+    MessageCall mc;
+    mc.to = contract;
+    mc.data = eevm::to_bytes(abi_append(compiled.hashes["add(uint256)"], 1));
+    auto in = ethrpc::SendRawTransaction::make(sn++);
+    in.params.raw_transaction = owner.sign_transaction(i + 1, mc);
+    do_rpc(frontend, owner.cert, in);
+  }
+
+  owner.contract_call(contract, compiled.hashes["get()"]);
+
+  {
+    INFO("Only operators can read metrics");
+    do_rpc(frontend, owner.cert, apprpc::GetMetrics::make(sn++), false);
+  }
+
+  {
+    auto in = ethrpc::GetBalance::make(sn++);
+    in.params.address = owner.address;
+    do_rpc(frontend, cert, in);
+  }
+
+  const auto metrics = get_metrics();
+
+  auto count = [&](const std::string& method, const std::string& phase) {
+    return metrics[method][phase]["count"].get<size_t>();
+  };
+
+  {
+    INFO("Each phase is recorded once per request");
+    const auto raw = ethrpc::SendRawTransaction::name;
+    for (const auto phase : {"handler",
+                             "parse_params",
+                             "recover_sender",
+                             "make_state",
+                             "execute",
+                             "hash_transaction",
+                             "write_receipt",
+                             "serialise_response"})
+    {
+      INFO(phase);
+      REQUIRE(count(raw, phase) == n_transactions);
+    }
+
+    REQUIRE(count(ethrpc::SendTransaction::name, "handler") == 1);
+    REQUIRE(count(ethrpc::SendTransaction::name, "execute") == 1);
+    REQUIRE(count(ethrpc::Call::name, "execute") == 1);
+  }
+
+  {
+    INFO("Phases which a method does not reach are omitted");
+    const auto& balance = metrics[ethrpc::GetBalance::name];
+    REQUIRE(balance["handler"]["count"] == 1);
+    REQUIRE(balance.contains("make_state"));
+    REQUIRE(!balance.contains("execute"));
+    REQUIRE(!balance.contains("recover_sender"));
+    REQUIRE(!metrics[ethrpc::Call::name].contains("recover_sender"));
+  }
+
+  {
+    INFO("Histograms account for every request");
+    const auto& handler = metrics[ethrpc::SendRawTransaction::name]["handler"];
+    size_t total = 0;
+    for (const auto& bucket : handler["histogram"])
+    {
+      total += bucket["count"].get<size_t>();
+    }
+    REQUIRE(total == n_transactions);
+    REQUIRE(handler["max_ns"] >= handler["mean_ns"]);
+  }
+}
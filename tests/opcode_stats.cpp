@@ -0,0 +1,165 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#include "../src/app/opcode_stats.h"
+#include "shared.h"
+
+#include <doctest/doctest.h>
+#include <eEVM/opcode.h>
+
+using namespace ccf;
+using namespace evm4ccf;
+
+TEST_CASE("Aggregation" * doctest::test_suite("opcodestats"))
+{
+  opcode_stats::Registry registry;
+
+  const eevm::Address a = 0xa;
+  const eevm::Address b = 0xb;
+
+  opcode_stats::OpcodeCounts counts = {};
+  counts[eevm::Opcode::SLOAD] = 2;
+  counts[eevm::Opcode::ADD] = 5;
+
+  opcode_stats::OpcodeCounts stop = {};
+  stop[eevm::Opcode::STOP] = 1;
+
+  // In the first execution a executes 7 of the 14 opcodes, so gets half of
+  // its time
+  registry.record({{a, counts}, {b, counts}}, 100);
+  registry.record({{a, counts}}, 50);
+  registry.record({{b, stop}}, 10);
+
+  const auto j = registry.to_json();
+  REQUIRE(j.size() == 2);
+
+  const auto& stats = j[keccak::to_checksum_address(a)];
+  REQUIRE(stats["executions"] == 2);
+  REQUIRE(stats["time"] == 100);
+  REQUIRE(stats["timePerOpcode"] == 100 / 14);
+  REQUIRE(stats["timeUnit"] == opcode_stats::time_unit);
+  REQUIRE(stats["opcodes"].size() == 2);
+  REQUIRE(stats["opcodes"]["0x54"] == 4);
+  REQUIRE(stats["opcodes"]["0x1"] == 10);
+
+  const auto& b_stats = j[keccak::to_checksum_address(b)];
+  REQUIRE(b_stats["executions"] == 2);
+  REQUIRE(b_stats["time"] == 60);
+  REQUIRE(b_stats["opcodes"].size() == 3);
+
+  registry.reset();
+  REQUIRE(registry.to_json().empty());
+}
+
+TEST_CASE("Attribution" * doctest::test_suite("opcodestats"))
+{
+  const eevm::Address a = 0xa;
+  const eevm::Address b = 0xb;
+  const eevm::Address c = 0xc;
+  constexpr size_t a_nonce = 7;
+
+  // Stack for a call to callee, with the gas limit on top
+  auto call_stack = [](const eevm::Address& callee) {
+    eevm::Stack s;
+    s.push(callee);
+    s.push(100000);
+    return s;
+  };
+
+  // a calls b, then runs b's code in its own account with DELEGATECALL. That
+  // creates a contract, which is a's to create since it holds the account.
+  // Finally a calls c, which has no code, so no frame is entered
+  eevm::Trace trace;
+  trace.add(0, eevm::Opcode::PUSH1, 1, eevm::Stack());
+  trace.add(2, eevm::Opcode::CALL, 1, call_stack(b));
+  trace.add(0, eevm::Opcode::ADD, 2, eevm::Stack());
+  trace.add(1, eevm::Opcode::STOP, 2, eevm::Stack());
+  trace.add(3, eevm::Opcode::DELEGATECALL, 1, call_stack(b));
+  trace.add(0, eevm::Opcode::CREATE, 2, eevm::Stack());
+  trace.add(0, eevm::Opcode::STOP, 3, eevm::Stack());
+  trace.add(1, eevm::Opcode::STOP, 2, eevm::Stack());
+  trace.add(4, eevm::Opcode::CALL, 1, call_stack(c));
+  trace.add(5, eevm::Opcode::STOP, 1, eevm::Stack());
+
+  std::vector<eevm::Address> nonces_read;
+  const auto counts =
+    opcode_stats::count_opcodes(trace, a, [&](const eevm::Address& address) {
+      nonces_read.push_back(address);
+      return a_nonce;
+    });
+
+  const auto created = keccak::generate_address(a, a_nonce);
+  REQUIRE(counts.size() == 3);
+  REQUIRE(nonces_read == std::vector<eevm::Address>{a});
+
+  const auto& a_counts = counts.at(a);
+  REQUIRE(opcode_stats::total(a_counts) == 5);
+  REQUIRE(a_counts[eevm::Opcode::CALL] == 2);
+  REQUIRE(a_counts[eevm::Opcode::DELEGATECALL] == 1);
+
+  const auto& b_counts = counts.at(b);
+  REQUIRE(opcode_stats::total(b_counts) == 4);
+  REQUIRE(b_counts[eevm::Opcode::CREATE] == 1);
+
+  REQUIRE(opcode_stats::total(counts.at(created)) == 1);
+  REQUIRE(counts.find(c) == counts.end());
+}
+
+#ifdef RECORD_OPCODE_STATS
+TEST_CASE("OpcodeStats0" * doctest::test_suite("opcodestats"))
+{
+  NetworkTables nwt;
+  StubNotifier stubn;
+  Store& tables = *nwt.tables;
+  auto cert = setup_tables(tables);
+  Ethereum frontend = ccfapp::get_rpc_handler(nwt, stubn);
+  jsonrpc::SeqNo sn = 0;
+
+  const auto compiled = read_bytecode("SimpleStore");
+  TestAccount owner(frontend, tables);
+  add_operator(tables, cert, owner.address);
+
+  auto get_stats = [&]() {
+    auto in = apprpc::GetOpcodeStats::make(sn++);
+    const apprpc::GetOpcodeStats::Out out = do_rpc(frontend, cert, in);
+    return out.result;
+  };
+
+  const auto contract = owner.deploy_contract(abi_append(compiled.deploy, 1));
+  const auto contract_key = keccak::to_checksum_address(contract);
+
+  constexpr size_t n_calls = 3;
+  for (size_t i = 0; i < n_calls; ++i)
+  {
+    owner.contract_call(contract, compiled.hashes["get()"]);
+  }
+
+  {
+    INFO("Executions are aggregated by contract");
+    const auto stats = get_stats();
+    REQUIRE(stats.contains(contract_key));
+    const auto& simple_store = stats[contract_key];
+
+    // The deployment ran the constructor at the contract's address
+    REQUIRE(simple_store["executions"] == n_calls + 1);
+    REQUIRE(simple_store["timeUnit"] == opcode_stats::time_unit);
+
+    // get() loads its storage slot on every call
+    const auto sload = hex::to_hex_string(uint64_t(eevm::Opcode::SLOAD));
+    REQUIRE(simple_store["opcodes"][sload] >= n_calls);
+  }
+
+  {
+    INFO("Only operators can read or reset statistics");
+    do_rpc(frontend, owner.cert, apprpc::GetOpcodeStats::make(sn++), false);
+    do_rpc(frontend, owner.cert, apprpc::ResetOpcodeStats::make(sn++), false);
+    REQUIRE(!get_stats().empty());
+  }
+
+  {
+    INFO("Statistics can be reset");
+    auto in = apprpc::ResetOpcodeStats::make(sn++);
+    do_rpc(frontend, cert, in);
+    REQUIRE(get_stats().empty());
+  }
+}
+#endif
@@ -93,7 +93,8 @@ evm4ccf::ByteData make_deployment_code(const evm4ccf::ByteData& runtime_code)
   return eevm::to_hex_string(deploy_bytecode);
 }
 
-CompiledBytecode read_bytecode(const std::string& contract_name)
+CompiledBytecode read_bytecode(
+  const std::string& contract_name, const std::string& file_name)
 {
   constexpr auto env_var = "CONTRACTS_DIR";
   const auto contracts_dir = getenv(env_var);
@@ -104,12 +105,13 @@ CompiledBytecode read_bytecode(const std::string& contract_name)
       "', but environment var " + env_var + " is not set");
   }
 
+  const auto& name = file_name.empty() ? contract_name : file_name;
   const std::string contract_path =
-    std::string(contracts_dir) + "/" + contract_name + "_combined.json";
+    std::string(contracts_dir) + "/" + name + "_combined.json";
 
   const auto j = files::slurp_json(contract_path);
 
-  const std::string element_id = contract_name + ".sol:" + contract_name;
+  const std::string element_id = name + ".sol:" + contract_name;
   const auto contract_element = j["contracts"][element_id];
   const evm4ccf::ByteData deploy =
     "0x" + contract_element["bin"].get<std::string>();
@@ -232,6 +234,14 @@ nlohmann::json TestAccount::contract_transact_raw(
   return do_rpc(frontend, cert, in, expect_success);
 }
 
+ByteData TestAccount::sign_transaction(
+  size_t nonce, const MessageCall& call_data) const
+{
+  const auto signed_tx = evm4ccf::sign_transaction(
+    *privk, EthereumTransaction(nonce, call_data));
+  return hex::to_hex_string(signed_tx.encode());
+}
+
 nlohmann::json TestAccount::contract_call_raw(
   const DeployedContract& contract,
   const ByteData& code,
@@ -2,6 +2,7 @@
 // Licensed under the MIT License.
 #pragma once
 
+#include "../src/app/tables.h"
 #include "node/encryptor.h"
 #include "node/networkstate.h"
 #include "rpc_types.h"
@@ -52,6 +53,31 @@ inline std::vector<uint8_t> add_user_cert(ccf::Store& tables)
   return cert;
 }
 
+// Makes the user with this cert an operator, as governance would. Must be
+// called after the frontend has created its tables
+inline void add_operator(
+  ccf::Store& tables,
+  const std::vector<uint8_t>& cert,
+  const eevm::Address& address)
+{
+  auto certs = tables.get<ccf::Certs>(ccf::Tables::USER_CERTS);
+  auto operators = tables.get<evm4ccf::tables::Operators>("eth.operators");
+
+  ccf::Store::Tx tx;
+
+  const auto user_id = tx.get_view(*certs)->get(cert);
+  if (!user_id.has_value())
+  {
+    throw std::logic_error("operator must be an existing user");
+  }
+
+  tx.get_view(*operators)->put(*user_id, address);
+  if (tx.commit() != kv::CommitSuccess::OK)
+  {
+    throw std::runtime_error("operator creation tx failed");
+  }
+}
+
 nlohmann::json do_rpc(
   Ethereum& handler,
   const std::vector<uint8_t>& cert,
@@ -89,7 +115,10 @@ struct CompiledBytecode
   evm4ccf::ByteData runtime;
   nlohmann::json hashes;
 };
-CompiledBytecode read_bytecode(const std::string& contract_name);
+// Reads a contract compiled by tests/contracts/compile.sh. The file name
+// defaults to the contract name
+CompiledBytecode read_bytecode(
+  const std::string& contract_name, const std::string& file_name = {});
 
 struct DeployedContract
 {
@@ -143,6 +172,11 @@ public:
     return out.result;
   }
 
+  // Hex-encoded transaction signed by this account, as accepted by
+  // eth_sendRawTransaction
+  evm4ccf::ByteData sign_transaction(
+    size_t nonce, const evm4ccf::MessageCall& call_data) const;
+
   nlohmann::json contract_call_raw(
     const DeployedContract& contract,
     const evm4ccf::ByteData& code,
@@ -91,6 +91,16 @@ TEST_CASE("Transaction roundtrip" * doctest::test_suite("signed transactions"))
 
     // Encode and decode, check result is identical
     const auto encoded = tx.encode();
+    {
+      const MessageCall mc(j["call"].get<rpcparams::MessageCall>());
+      CHECK(mc.data == tx.data);
+      CHECK(encode_unsigned_transaction(tx.nonce, mc) == encoded);
+
+      MessageCall decoded_mc;
+      EthereumTransaction(encoded).to_message_call(decoded_mc);
+      CHECK(decoded_mc.to == mc.to);
+      CHECK(decoded_mc.data == mc.data);
+    }
     {
       const auto decoded = EthereumTransaction(encoded);
       CHECK(tx.nonce == decoded.nonce);
@@ -128,6 +138,31 @@ TEST_CASE("Transaction roundtrip" * doctest::test_suite("signed transactions"))
       CHECK(with_signature.s == decoded.s);
     }
 
+    // Decode signed transaction in place, check views match owned fields
+    {
+      const SignedTransactionView view(
+        {encoded_with_signature.data(), encoded_with_signature.size()});
+      CHECK(view.nonce == with_signature.nonce);
+      CHECK(view.gas_price == with_signature.gas_price);
+      CHECK(view.gas == with_signature.gas);
+      CHECK(
+        eevm::rlp::ByteString(view.to.p, view.to.p + view.to.n) ==
+        with_signature.to);
+      CHECK(view.value == with_signature.value);
+      CHECK(
+        eevm::rlp::ByteString(view.data.p, view.data.p + view.data.n) ==
+        with_signature.data);
+      CHECK(view.v == with_signature.v);
+      CHECK(view.r == with_signature.r);
+      CHECK(view.s == with_signature.s);
+      CHECK(view.to_be_signed() == with_signature.to_be_signed());
+
+      MessageCall mc;
+      view.to_message_call(mc);
+      CHECK(mc.from == from);
+      CHECK(mc.data == tx.data);
+    }
+
     // Check recovered address matches signing address
     tls::RecoverableSignature rec_sig;
     with_signature.to_recoverable_signature(rec_sig);
@@ -466,3 +501,223 @@ TEST_CASE("Sample txs" * doctest::test_suite("signed transactions"))
       "0xb30ac593f18a3ad64361107bca6fdf0b36f4aa4d73c898fbe53e95e2487562a8");
   }
 }
+
+TEST_CASE("Non-canonical RLP" * doctest::test_suite("signed transactions"))
+{
+  const auto decode = [](const std::string& s) {
+    const auto bytes = eevm::to_bytes(s);
+    return rlp_view::decode({bytes.data(), bytes.size()});
+  };
+
+  // Canonical encodings
+  CHECK(decode("0x05").payload.n == 1);
+  CHECK(decode("0x8180").payload.n == 1);
+  CHECK(decode("0x80").payload.n == 0);
+  CHECK(decode("0xc3010203").is_list);
+  CHECK(decode("0xb838" + std::string(56 * 2, 'a')).payload.n == 56);
+
+  // Single byte below 0x80 wrapped in a string prefix
+  CHECK_THROWS_AS(decode("0x8105"), rlp_view::DecodeError);
+
+  // Long form used for a short length
+  CHECK_THROWS_AS(decode("0xb80100"), rlp_view::DecodeError);
+
+  // Length with leading zeros
+  CHECK_THROWS_AS(
+    decode("0xb90038" + std::string(56 * 2, 'a')), rlp_view::DecodeError);
+
+  // Truncated input
+  CHECK_THROWS_AS(decode("0x83aabb"), rlp_view::DecodeError);
+  CHECK_THROWS_AS(decode("0xc3aabb"), rlp_view::DecodeError);
+
+  // Trailing bytes
+  CHECK_THROWS_AS(decode("0x0102"), rlp_view::DecodeError);
+
+  // Integers with leading zeros
+  {
+    const auto bytes = eevm::to_bytes("0xc3820001");
+    rlp_view::ListReader reader(rlp_view::decode({bytes.data(), bytes.size()}));
+    CHECK_THROWS_AS(reader.next_int<size_t>(), rlp_view::DecodeError);
+  }
+}
+
+TEST_CASE(
+  "Access list transactions" * doctest::test_suite("signed transactions"))
+{
+  current_chain_id = ChainIDs::ethereum_mainnet;
+
+  auto kp = tls::KeyPair_k1Bitcoin(MBEDTLS_ECP_DP_SECP256K1);
+  const auto from = get_address_from_public_key_asn1(kp.public_key_asn1());
+
+  MessageCall mc;
+  mc.to = 0xabc;
+  mc.gas_price = 1;
+  mc.gas = 0x5208;
+  mc.value = 0x10;
+  mc.data = {0xc0, 0xde};
+  mc.type = access_list_transaction_type;
+  mc.access_list = {{0xaa, {0, 1}}};
+
+  const EthereumTransaction tx(3, mc);
+  CHECK(tx.type == access_list_transaction_type);
+  CHECK(tx.chain_id == ChainIDs::ethereum_mainnet);
+
+  {
+    INFO("Unsigned fields are encoded after the type byte, per EIP-2930");
+    const auto encoded = tx.encode();
+    CHECK(
+      encoded ==
+      eevm::to_bytes(
+        "0x01f87c010301825208940000000000000000000000000000000000000abc1082c0"
+        "def85bf8599400000000000000000000000000000000000000aaf842a00000000000"
+        "000000000000000000000000000000000000000000000000000000a0000000000000"
+        "0000000000000000000000000000000000000000000000000001"));
+    CHECK(encode_unsigned_transaction(3, mc) == encoded);
+
+    const EthereumTransaction decoded(encoded);
+    CHECK(decoded.type == access_list_transaction_type);
+    CHECK(decoded.chain_id == tx.chain_id);
+    CHECK(decoded.nonce == tx.nonce);
+    CHECK(decoded.to == tx.to);
+    CHECK(decoded.data == tx.data);
+    CHECK(decoded.access_list == mc.access_list);
+  }
+
+  const auto with_signature = sign_transaction(kp, tx);
+  CHECK(with_signature.v <= 1);
+
+  const auto encoded_with_signature = with_signature.encode();
+  CHECK(encoded_with_signature[0] == access_list_transaction_type);
+
+  {
+    INFO("Signed transactions roundtrip, owned and in place");
+    const auto decoded =
+      EthereumTransactionWithSignature(encoded_with_signature);
+    CHECK(decoded.encode() == encoded_with_signature);
+    CHECK(decoded.access_list == mc.access_list);
+    CHECK(decoded.v == with_signature.v);
+    CHECK(decoded.r == with_signature.r);
+    CHECK(decoded.s == with_signature.s);
+
+    const SignedTransactionView view(
+      {encoded_with_signature.data(), encoded_with_signature.size()});
+    CHECK(view.type == access_list_transaction_type);
+    CHECK(view.chain_id == ChainIDs::ethereum_mainnet);
+    CHECK(view.to_be_signed() == with_signature.to_be_signed());
+    CHECK(view.to_be_signed() == keccak::keccak_256(tx.encode()));
+
+    MessageCall decoded_mc;
+    view.to_message_call(decoded_mc);
+    CHECK(decoded_mc.from == from);
+    CHECK(decoded_mc.to == mc.to);
+    CHECK(decoded_mc.data == mc.data);
+    CHECK(decoded_mc.access_list == mc.access_list);
+
+    MessageCall owned_mc;
+    decoded.to_message_call(owned_mc);
+    CHECK(owned_mc.from == from);
+  }
+
+  {
+    INFO("The envelope's type is kept when the access list is empty");
+    auto empty_mc = mc;
+    empty_mc.access_list.clear();
+
+    const EthereumTransaction empty_tx(3, empty_mc);
+    CHECK(empty_tx.type == access_list_transaction_type);
+    const auto encoded = empty_tx.encode();
+    CHECK(encoded[0] == access_list_transaction_type);
+    CHECK(encode_unsigned_transaction(3, empty_mc) == encoded);
+
+    auto legacy_mc = empty_mc;
+    legacy_mc.type = legacy_transaction_type;
+    CHECK(encode_unsigned_transaction(3, legacy_mc) != encoded);
+
+    const auto signed_empty = sign_transaction(kp, empty_tx).encode();
+    const SignedTransactionView view(
+      {signed_empty.data(), signed_empty.size()});
+    CHECK(view.type == access_list_transaction_type);
+    CHECK(view.to_be_signed() == keccak::keccak_256(encoded));
+
+    MessageCall decoded_mc;
+    view.to_message_call(decoded_mc);
+    CHECK(decoded_mc.from == from);
+    CHECK(decoded_mc.type == access_list_transaction_type);
+    CHECK(decoded_mc.access_list.empty());
+    CHECK(encode_unsigned_transaction(3, decoded_mc) == encoded);
+
+    const EthereumTransactionWithSignature decoded(signed_empty);
+    CHECK(decoded.type == access_list_transaction_type);
+    CHECK(decoded.encode() == signed_empty);
+  }
+
+  {
+    INFO("Legacy transactions cannot carry an access list");
+    auto legacy_mc = mc;
+    legacy_mc.type = legacy_transaction_type;
+    CHECK_THROWS_AS(
+      encode_unsigned_transaction(3, legacy_mc), std::logic_error);
+    CHECK_THROWS_AS(EthereumTransaction(3, legacy_mc), std::logic_error);
+  }
+
+  {
+    INFO("Transactions for another chain are rejected");
+    current_chain_id = ChainIDs::ropsten;
+    const SignedTransactionView view(
+      {encoded_with_signature.data(), encoded_with_signature.size()});
+    MessageCall decoded_mc;
+    CHECK_THROWS_AS(view.to_message_call(decoded_mc), std::logic_error);
+    current_chain_id = ChainIDs::ethereum_mainnet;
+  }
+
+  {
+    INFO("Unknown transaction types are rejected");
+    auto unknown = encoded_with_signature;
+    unknown[0] = 0x02;
+    CHECK_THROWS_AS(
+      SignedTransactionView({unknown.data(), unknown.size()}),
+      rlp_view::DecodeError);
+  }
+
+  {
+    INFO("Access lists are accepted in JSON calls");
+    const auto j = R"xxx(
+      {
+        "from": "0x0123",
+        "to": "0x0abc",
+        "accessList": [
+          {
+            "address": "0x00000000000000000000000000000000000000aa",
+            "storageKeys": [
+              "0x0000000000000000000000000000000000000000000000000000000000000000",
+              "0x0000000000000000000000000000000000000000000000000000000000000001"
+            ]
+          }
+        ]
+      }
+    )xxx"_json;
+    const auto tc = j.get<rpcparams::MessageCall>();
+    CHECK(tc.type == access_list_transaction_type);
+    CHECK(tc.access_list == mc.access_list);
+    CHECK(
+      nlohmann::json(tc).get<rpcparams::MessageCall>().access_list ==
+      mc.access_list);
+
+    const auto empty = R"xxx(
+      {"from": "0x0123", "to": "0x0abc", "type": "0x1", "accessList": []}
+    )xxx"_json;
+    const auto empty_tc = empty.get<rpcparams::MessageCall>();
+    CHECK(empty_tc.type == access_list_transaction_type);
+    CHECK(empty_tc.access_list.empty());
+    CHECK(
+      nlohmann::json(empty_tc).get<rpcparams::MessageCall>().type ==
+      access_list_transaction_type);
+
+    auto legacy = j;
+    legacy["type"] = "0x0";
+    CHECK_THROWS_AS(
+      legacy.get<rpcparams::MessageCall>(), std::invalid_argument);
+  }
+
+  current_chain_id = ChainIDs::pre_eip_155;
+}
@@ -0,0 +1,255 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#include "../src/app/state_history.h"
+#include "shared.h"
+
+#include <doctest/doctest.h>
+
+using namespace ccf;
+using namespace evm4ccf;
+
+TEST_CASE("HistoricalReads" * doctest::test_suite("history"))
+{
+  NetworkTables nwt;
+  StubNotifier stubn;
+  Store& tables = *nwt.tables;
+  auto cert = setup_tables(tables);
+  Ethereum frontend = ccfapp::get_rpc_handler(nwt, stubn);
+  jsonrpc::SeqNo sn = 0;
+
+  const auto compiled = read_bytecode("SimpleStore");
+  const auto add2 = abi_append(compiled.hashes["add(uint256)"], 2);
+
+  TestAccount owner(frontend, tables);
+
+  // Each transaction is sealed in its own block after the genesis block, so
+  // the stored value is 15 + 2(n - 1) at the end of block n
+  const auto contract = owner.deploy_contract(abi_append(compiled.deploy, 15));
+  constexpr size_t n_adds = 4;
+  for (size_t i = 0; i < n_adds; ++i)
+  {
+    owner.contract_transact(contract, add2);
+  }
+
+  auto get_value = [&](const BlockID& id) {
+    auto in = ethrpc::Call::make(sn++);
+    in.params.call_data.from = owner.address;
+    in.params.call_data.to = contract;
+    in.params.call_data.data = compiled.hashes["get()"];
+    in.params.block_id = id;
+    const ethrpc::Call::Out out = do_rpc(frontend, cert, in);
+    return get_result_value(out);
+  };
+
+  auto get_nonce = [&](const BlockID& id) {
+    auto in = ethrpc::GetTransactionCount::make(sn++);
+    in.params.address = owner.address;
+    in.params.block_id = id;
+    const ethrpc::GetTransactionCount::Out out = do_rpc(frontend, cert, in);
+    return out.result;
+  };
+
+  auto get_code = [&](const BlockID& id) {
+    auto in = ethrpc::GetCode::make(sn++);
+    in.params.address = contract;
+    in.params.block_id = id;
+    const ethrpc::GetCode::Out out = do_rpc(frontend, cert, in);
+    return out.result;
+  };
+
+  {
+    INFO("Reads at past blocks see the state at the end of that block");
+    for (size_t n = 1; n <= n_adds + 1; ++n)
+    {
+      const auto id = eevm::to_hex_string(n);
+      REQUIRE(get_value(id) == 15 + 2 * (n - 1));
+      REQUIRE(get_nonce(id) == n);
+      REQUIRE(get_code(id) == get_code("latest"));
+    }
+
+    // Nothing had been deployed at the genesis block
+    REQUIRE(get_nonce("earliest") == 0);
+    REQUIRE(eevm::to_bytes(get_code("earliest")).empty());
+    REQUIRE(get_value("latest") == 15 + 2 * n_adds);
+    REQUIRE(get_value("pending") == 15 + 2 * n_adds);
+  }
+
+  {
+    INFO("Transactions executed against past state have no lasting effect");
+    auto in = ethrpc::Call::make(sn++);
+    in.params.call_data.from = owner.address;
+    in.params.call_data.to = contract;
+    in.params.call_data.data = add2;
+    in.params.block_id = "0x1";
+    const ethrpc::Call::Out out = do_rpc(frontend, cert, in);
+    REQUIRE(get_result_value(out) == 17);
+
+    REQUIRE(get_value("0x1") == 15);
+    REQUIRE(get_value("latest") == 15 + 2 * n_adds);
+  }
+
+  {
+    INFO("Blocks which have not been sealed cannot be read");
+    auto in = ethrpc::GetBalance::make(sn++);
+    in.params.address = owner.address;
+    in.params.block_id = eevm::to_hex_string(n_adds + 2);
+    do_rpc(frontend, cert, in, false);
+
+    in.params.block_id = "0x100000";
+    do_rpc(frontend, cert, in, false);
+  }
+}
+
+TEST_CASE("Pruning" * doctest::test_suite("history"))
+{
+  Store store;
+  auto& balances =
+    store.create<tables::Accounts::Balances>("eth.account.balance");
+  tables::History history{
+    tables::History::Balances::create(store, "eth.history.balance"),
+    tables::History::Codes::create(store, "eth.history.code"),
+    tables::History::Nonces::create(store, "eth.history.nonce"),
+    tables::History::Storage::create(store, "eth.history.storage"),
+    store.create<tables::History::Created>("eth.history.created"),
+    store.create<tables::History::Deltas>("eth.history.deltas")};
+
+  const eevm::Address a = 0xa;
+  const eevm::Address b = 0xb;
+  const eevm::Address c = 0xc;
+
+  // Sets a balance in a transaction at the given position
+  auto write = [&](
+                 const eevm::Address& address,
+                 uint64_t block,
+                 uint64_t index,
+                 const uint256_t& value) {
+    Store::Tx tx;
+    auto balances_view = tx.get_view(balances);
+    history::Recorder recorder(history.get_views(tx), block);
+    recorder.balance(address, balances_view->get(address).value_or(0));
+    balances_view->put(address, value);
+
+    // Later writes in the same transaction are not recorded again
+    recorder.balance(address, value);
+    recorder.write_delta(index);
+    REQUIRE(tx.commit() == kv::CommitSuccess::OK);
+  };
+
+  // Reads a balance at the end of a block
+  auto read = [&](const eevm::Address& address, uint64_t block) {
+    Store::Tx tx;
+    auto balances_view = tx.get_view(balances);
+    const history::PastState past{history.get_views(tx), block};
+    return history::read_at(past.views.balances, address, past, [&]() {
+      return balances_view->get(address).value_or(0);
+    });
+  };
+
+  auto recorded = [&](const eevm::Address& address, uint64_t block) {
+    Store::Tx tx;
+    return tx.get_view(history.balances.values)
+      ->get(std::make_pair(address, block));
+  };
+
+  // a is written in blocks 3, 5 (twice), 6, 40 and 70, and b once in block
+  // 5. Blocks 40 and 70 are indexed in later buckets than the others
+  write(a, 3, 0, 10);
+  write(a, 5, 0, 20);
+  write(a, 5, 1, 21);
+  write(b, 5, 2, 7);
+  write(a, 6, 0, 30);
+  write(a, 40, 0, 40);
+  write(a, 70, 0, 70);
+
+  // c is created in block 5
+  {
+    Store::Tx tx;
+    history::Recorder recorder(history.get_views(tx), 5);
+    recorder.created(c);
+    tx.get_view(balances)->put(c, 1);
+    recorder.write_delta(3);
+    REQUIRE(tx.commit() == kv::CommitSuccess::OK);
+  }
+
+  auto existed = [&](const eevm::Address& address, uint64_t block) {
+    Store::Tx tx;
+    return history::existed_at(
+      address, history::PastState{history.get_views(tx), block});
+  };
+
+  {
+    INFO("Each block records the value from before its first write");
+    REQUIRE(recorded(a, 3) == 0);
+    REQUIRE(recorded(a, 5) == 10);
+    REQUIRE(recorded(a, 6) == 21);
+    REQUIRE(recorded(b, 5) == 0);
+    REQUIRE(!recorded(a, 4).has_value());
+  }
+
+  {
+    INFO("Reads see the value at the end of the block");
+    REQUIRE(read(a, 0) == 0);
+    REQUIRE(read(a, 2) == 0);
+    REQUIRE(read(a, 3) == 10);
+    REQUIRE(read(a, 4) == 10);
+    REQUIRE(read(a, 5) == 21);
+    REQUIRE(read(a, 6) == 30);
+    REQUIRE(read(b, 4) == 0);
+    REQUIRE(read(b, 5) == 7);
+  }
+
+  {
+    INFO("Reads find the next write in a later bucket");
+    REQUIRE(read(a, 7) == 30);
+    REQUIRE(read(a, 39) == 30);
+    REQUIRE(read(a, 40) == 40);
+    REQUIRE(read(a, 64) == 40);
+    REQUIRE(read(a, 70) == 70);
+    REQUIRE(read(a, 100) == 70);
+  }
+
+  {
+    INFO("Accounts did not exist before the block which created them");
+    REQUIRE(!existed(c, 4));
+    REQUIRE(existed(c, 5));
+    REQUIRE(existed(a, 0));
+    REQUIRE(read(c, 4) == 0);
+    REQUIRE(read(c, 5) == 1);
+  }
+
+  {
+    Store::Tx tx;
+    history::prune(history.get_views(tx), 5, 4);
+    REQUIRE(tx.commit() == kv::CommitSuccess::OK);
+  }
+
+  {
+    INFO("Pruning a block removes only what was recorded in it");
+    REQUIRE(!recorded(a, 5).has_value());
+    REQUIRE(!recorded(b, 5).has_value());
+    REQUIRE(recorded(a, 3) == 0);
+    REQUIRE(recorded(a, 6) == 21);
+
+    Store::Tx tx;
+    auto deltas = tx.get_view(history.deltas);
+    for (uint64_t index = 0; index < 4; ++index)
+    {
+      REQUIRE(!deltas->get(std::make_pair(uint64_t(5), index)).has_value());
+    }
+    REQUIRE(deltas->get(std::make_pair(uint64_t(6), uint64_t(0))).has_value());
+
+    // b and c were only written in block 5, so nothing is indexed for them
+    auto buckets = tx.get_view(history.balances.buckets);
+    REQUIRE(!buckets->get(b).has_value());
+    REQUIRE(!buckets->get(c).has_value());
+    REQUIRE(buckets->get(a).has_value());
+    REQUIRE(!tx.get_view(history.created)->get(c).has_value());
+  }
+
+  {
+    INFO("Blocks after the pruned block can still be read");
+    REQUIRE(read(a, 5) == 21);
+    REQUIRE(read(a, 6) == 30);
+    REQUIRE(read(b, 5) == 7);
+  }
+}
@@ -0,0 +1,178 @@
+// Copyright (c) Microsoft Corporation. All rights reserved.
+// Licensed under the MIT License.
+#include "../src/app/tracing.h"
+#include "shared.h"
+
+#include <doctest/doctest.h>
+
+using namespace ccf;
+using namespace evm4ccf;
+
+TEST_CASE("Sampling" * doctest::test_suite("tracing"))
+{
+  const eevm::Address a = 0xa;
+  const eevm::Address b = 0xb;
+  const eevm::Address c = 0xc;
+
+  auto count_traced = [&](tracing::Sampler& sampler, size_t n) {
+    size_t traced = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+      if (sampler.should_trace(a, b))
+      {
+        ++traced;
+      }
+    }
+    return traced;
+  };
+
+  {
+    INFO("Nothing is traced when sampling is disabled");
+    tracing::Sampler sampler(0, 16);
+    REQUIRE(count_traced(sampler, 10) == 0);
+  }
+
+  {
+    INFO("1 in every K executions is traced");
+    tracing::Sampler sampler(3, 16);
+    REQUIRE(count_traced(sampler, 9) == 3);
+    REQUIRE(sampler.to_json()["traced"] == 3);
+
+    sampler.configure(1, 1, 16, {});
+    REQUIRE(count_traced(sampler, 5) == 5);
+
+    INFO("A generation which is already applied is ignored");
+    sampler.configure(1, 0, 16, {});
+    REQUIRE(count_traced(sampler, 5) == 5);
+  }
+
+  {
+    INFO("Executions from or to forced addresses are always traced");
+    tracing::Sampler sampler(0, 16);
+    sampler.configure(1, 0, 16, {b});
+    REQUIRE(sampler.should_trace(a, b));
+    REQUIRE(sampler.should_trace(b, c));
+    REQUIRE(!sampler.should_trace(a, c));
+
+    sampler.configure(2, 0, 16, {});
+    REQUIRE(!sampler.should_trace(a, b));
+
+    INFO("Requests can force their own execution to be traced");
+    REQUIRE(sampler.should_trace(a, b, true));
+    REQUIRE(sampler.to_json()["traced"] == 3);
+  }
+
+  {
+    INFO("Only the most recent failures are kept");
+    tracing::Sampler sampler(1, 16);
+    eevm::Trace tr;
+    for (size_t i = 0; i < tracing::max_failures + 3; ++i)
+    {
+      sampler.record_failure(tr);
+    }
+    REQUIRE(sampler.to_json()["failures"].size() == tracing::max_failures);
+  }
+}
+
+TEST_CASE("Tracing0" * doctest::test_suite("tracing"))
+{
+  NetworkTables nwt;
+  StubNotifier stubn;
+  Store& tables = *nwt.tables;
+  auto cert = setup_tables(tables);
+  Ethereum frontend = ccfapp::get_rpc_handler(nwt, stubn);
+  jsonrpc::SeqNo sn = 0;
+
+  auto get_tracing = [&]() {
+    auto in = apprpc::GetTracing::make(sn++);
+    const apprpc::GetTracing::Out out = do_rpc(frontend, cert, in);
+    return out.result;
+  };
+
+  auto set_tracing = [&](
+                       const rpcparams::SetTracing& params,
+                       bool expect_success = true) {
+    auto in = apprpc::SetTracing::make(sn++);
+    in.params = params;
+    do_rpc(frontend, cert, in, expect_success);
+  };
+
+  const auto compiled = read_bytecode("SimpleStore");
+  TestAccount owner(frontend, tables);
+  TestAccount other(frontend, tables);
+  add_operator(tables, cert, owner.address);
+  const auto contract = owner.deploy_contract(abi_append(compiled.deploy, 1));
+
+  auto call_get = [&](TestAccount& from, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+    {
+      from.contract_call(contract, compiled.hashes["get()"]);
+    }
+  };
+
+  const auto initially = get_tracing();
+  const auto initially_traced = initially["traced"].get<size_t>();
+
+  {
+    INFO("Only operators can read or change the settings");
+    do_rpc(frontend, other.cert, apprpc::GetTracing::make(sn++), false);
+
+    auto in = apprpc::SetTracing::make(sn++);
+    in.params.sample_every = 1;
+    do_rpc(frontend, other.cert, in, false);
+    REQUIRE(get_tracing()["sampleEvery"] == initially["sampleEvery"]);
+  }
+
+  {
+    INFO("Sampling applies to every execution");
+    rpcparams::SetTracing params;
+    params.sample_every = 2;
+    params.tail_length = 8;
+    set_tracing(params);
+
+    const auto j = get_tracing();
+    REQUIRE(j["sampleEvery"] == 2);
+    REQUIRE(j["tailLength"] == 8);
+
+    call_get(owner, 4);
+    REQUIRE(get_tracing()["traced"] == initially_traced + 2);
+  }
+
+  {
+    INFO("Operators can only force tracing of their own address");
+    rpcparams::SetTracing params;
+    params.addresses.insert(other.address);
+    set_tracing(params, false);
+  }
+
+  {
+    INFO("Forced addresses are traced regardless of sampling");
+    rpcparams::SetTracing params;
+    params.addresses.insert(owner.address);
+    set_tracing(params);
+
+    REQUIRE(
+      get_tracing()["addresses"][0] ==
+      keccak::to_checksum_address(owner.address));
+
+    call_get(owner, 3);
+    call_get(other, 3);
+    REQUIRE(get_tracing()["traced"] == initially_traced + 5);
+  }
+
+  {
+    INFO("Any request can ask for its execution to be traced");
+    auto in = ethrpc::Call::make(sn++);
+    in.params.call_data.from = other.address;
+    in.params.call_data.to = contract;
+    in.params.call_data.data = compiled.hashes["get()"];
+    in.params.trace = true;
+    do_rpc(frontend, other.cert, in);
+    REQUIRE(get_tracing()["traced"] == initially_traced + 6);
+
+    // The options follow the standard params
+    const nlohmann::json j = in.params;
+    REQUIRE(j.size() == 3);
+    REQUIRE(j[2]["trace"] == true);
+  }
+}